@@ -0,0 +1,330 @@
+//============================================================================
+// Name        : BoxyLady
+// Author      : Darren Green
+// Copyright   : (C) Darren Green 2011-2025
+// Description : Music sequencer
+//
+// License GPLv3+: GNU GPL version 3 or later <http://gnu.org/licenses/gpl.html>
+// This is free software; you are free to change and redistribute it.
+// There is NO WARRANTY, to the extent permitted by law.
+// Contact: darren.green@stir.ac.uk http://pinkmongoose.co.uk
+//============================================================================
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <limits>
+#include <numbers>
+#include <utility>
+
+#include "Biquad.h"
+#include "Sound.h"
+
+namespace BoxyLady {
+
+namespace {
+
+// Sounds with more channels than the engine has lanes are filtered one
+// channel at a time through a mono copy.
+template <typename Function>
+void EachChannel(MusicVector& music_data, int channels, size_t frames, Function mono) {
+	const size_t stride {static_cast<size_t>(channels)};
+	MusicVector channel_data(frames);
+	for (size_t channel {0}; channel < stride; channel++) {
+		for (size_t frame {0}; frame < frames; frame++)
+			channel_data[frame] = music_data[frame * stride + channel];
+		mono(channel_data);
+		for (size_t frame {0}; frame < frames; frame++)
+			music_data[frame * stride + channel] = channel_data[frame];
+	}
+}
+
+} //end namespace
+
+Biquad Biquad::Normalise(float_type b0, float_type b1, float_type b2,
+		float_type a0, float_type a1, float_type a2) noexcept {
+	b0 /= a0;
+	b1 /= a0;
+	b2 /= a0;
+	a1 /= a0;
+	a2 /= a0;
+	return Biquad {b0, b1, b2, a1, a2};
+}
+
+Biquad Biquad::OnePoleLowPass(float_type a) noexcept {
+	return Biquad {a, 0.0, 0.0, -(1.0_flt - a), 0.0};
+}
+
+Biquad Biquad::OnePoleHighPass(float_type a) noexcept {
+	return Biquad {a, -a, 0.0, -a, 0.0};
+}
+
+Biquad Biquad::FirstOrderLowPass(float_type w0) noexcept {
+	const float_type K {tan(w0 / 2.0_flt)};
+	return Normalise(K, K, 0.0, K + 1.0_flt, K - 1.0_flt, 0.0);
+}
+
+Biquad Biquad::FirstOrderHighPass(float_type w0) noexcept {
+	const float_type K {tan(w0 / 2.0_flt)};
+	return Normalise(1.0, -1.0, 0.0, K + 1.0_flt, K - 1.0_flt, 0.0);
+}
+
+Biquad Biquad::LowPass(float_type w0, float_type Q) noexcept {
+	const float_type c {cos(w0)}, alpha {sin(w0) / (2.0_flt * Q)};
+	return Normalise((1.0_flt - c) / 2.0_flt, 1.0_flt - c, (1.0_flt - c) / 2.0_flt,
+		1.0_flt + alpha, -2.0_flt * c, 1.0_flt - alpha);
+}
+
+Biquad Biquad::HighPass(float_type w0, float_type Q) noexcept {
+	const float_type c {cos(w0)}, alpha {sin(w0) / (2.0_flt * Q)};
+	return Normalise((1.0_flt + c) / 2.0_flt, -(1.0_flt + c), (1.0_flt + c) / 2.0_flt,
+		1.0_flt + alpha, -2.0_flt * c, 1.0_flt - alpha);
+}
+
+Biquad Biquad::Peak(float_type w0, float_type bandwidth, float_type gain) noexcept {
+	const float_type A {pow(10.0_flt, gain / 40.0_flt)},
+		c {cos(w0)}, s {sin(w0)},
+		alpha {s * sinh(log(2.0_flt) / 2.0_flt * bandwidth * w0 / s)};
+	return Normalise(1.0_flt + alpha * A, -2.0_flt * c, 1.0_flt - alpha * A,
+		1.0_flt + alpha / A, -2.0_flt * c, 1.0_flt - alpha / A);
+}
+
+Biquad Biquad::Notch(float_type w0, float_type bandwidth) noexcept {
+	const float_type c {cos(w0)}, s {sin(w0)},
+		alpha {s * sinh(log(2.0_flt) / 2.0_flt * bandwidth * w0 / s)};
+	return Normalise(1.0, -2.0_flt * c, 1.0, 1.0_flt + alpha, -2.0_flt * c, 1.0_flt - alpha);
+}
+
+Biquad Biquad::LowShelf(float_type w0, float_type slope, float_type gain) noexcept {
+	const float_type A {pow(10.0_flt, gain / 40.0_flt)},
+		c {cos(w0)}, s {sin(w0)},
+		beta {2.0_flt * sqrt(A) * s / 2.0_flt * sqrt((A + 1.0_flt / A) * (1.0_flt / slope - 1.0_flt) + 2.0_flt)};
+	return Normalise(A * ((A + 1.0_flt) - (A - 1.0_flt) * c + beta),
+		2.0_flt * A * ((A - 1.0_flt) - (A + 1.0_flt) * c),
+		A * ((A + 1.0_flt) - (A - 1.0_flt) * c - beta),
+		(A + 1.0_flt) + (A - 1.0_flt) * c + beta,
+		-2.0_flt * ((A - 1.0_flt) + (A + 1.0_flt) * c),
+		(A + 1.0_flt) + (A - 1.0_flt) * c - beta);
+}
+
+Biquad Biquad::HighShelf(float_type w0, float_type slope, float_type gain) noexcept {
+	const float_type A {pow(10.0_flt, gain / 40.0_flt)},
+		c {cos(w0)}, s {sin(w0)},
+		beta {2.0_flt * sqrt(A) * s / 2.0_flt * sqrt((A + 1.0_flt / A) * (1.0_flt / slope - 1.0_flt) + 2.0_flt)};
+	return Normalise(A * ((A + 1.0_flt) + (A - 1.0_flt) * c + beta),
+		-2.0_flt * A * ((A - 1.0_flt) + (A + 1.0_flt) * c),
+		A * ((A + 1.0_flt) + (A - 1.0_flt) * c - beta),
+		(A + 1.0_flt) - (A - 1.0_flt) * c + beta,
+		2.0_flt * ((A - 1.0_flt) - (A + 1.0_flt) * c),
+		(A + 1.0_flt) - (A - 1.0_flt) * c - beta);
+}
+
+BiquadCascade BiquadCascade::Butterworth(float_type w0, int order, bool high) {
+	BiquadCascade cascade;
+	if (order % 2)
+		cascade.Add(high ? Biquad::FirstOrderHighPass(w0) : Biquad::FirstOrderLowPass(w0));
+	for (int pair {0}; pair < order / 2; pair++) {
+		const float_type theta {std::numbers::pi_v<float_type> * static_cast<float_type>(2 * pair + 1)
+			/ static_cast<float_type>(2 * order)},
+			Q {1.0_flt / (2.0_flt * sin(theta))};
+		cascade.Add(high ? Biquad::HighPass(w0, Q) : Biquad::LowPass(w0, Q));
+	}
+	return cascade;
+}
+
+BiquadCascade BiquadCascade::LinkwitzRiley(float_type w0, int order, bool high) {
+	if (order % 2)
+		throw EError("Linkwitz-Riley filters need an even order.");
+	const BiquadCascade half {Butterworth(w0, order / 2, high)};
+	return BiquadCascade{half}.Add(half);
+}
+
+size_t BiquadCascade::Settle() const noexcept {
+	constexpr float_type Residue {1e-7};
+	size_t frames {0};
+	for (const Biquad& section : sections_) {
+		const float_type discriminant {section.a1 * section.a1 - 4.0_flt * section.a2};
+		const float_type radius {(discriminant < 0.0_flt) ? std::sqrt(section.a2)
+			: (std::abs(section.a1) + std::sqrt(discriminant)) / 2.0_flt};
+		if (radius >= 1.0_flt)
+			return std::numeric_limits<size_t>::max();
+		if (radius > 0.0_flt)
+			frames += static_cast<size_t>(std::ceil(std::log(Residue) / std::log(radius)));
+		frames += 2;
+	}
+	return frames;
+}
+
+float_type BiquadCascade::PhaseDelay(float_type w) const noexcept {
+	const std::complex<float_type> z {std::polar(1.0_flt, -w)};
+	float_type phase {0.0};
+	for (const Biquad& section : sections_)
+		phase += std::arg((section.b0 + (section.b1 + section.b2 * z) * z)
+			/ (1.0_flt + (section.a1 + section.a2 * z) * z));
+	return -phase / w;
+}
+
+template <size_t Lanes>
+void BiquadCascade::Apply(float_type* buffer, size_t frames, State* states) const {
+	constexpr float_type Denormal {1e-30};
+	const size_t count {frames * Lanes};
+	for (size_t section_index {0}; section_index < sections_.size(); section_index++) {
+		const auto [b0, b1, b2, a1, a2] = sections_[section_index];
+		State& state {states[section_index]};
+		std::array<float_type, Lanes> x1, x2, y1, y2;
+		for (size_t lane {0}; lane < Lanes; lane++) {
+			x1[lane] = state.x1[lane];
+			x2[lane] = state.x2[lane];
+			y1[lane] = state.y1[lane];
+			y2[lane] = state.y2[lane];
+		}
+		for (size_t index {0}; index < count; index += Lanes)
+			for (size_t lane {0}; lane < Lanes; lane++) {
+				const float_type x {buffer[index + lane]},
+					y {(b0 * x + b1 * x1[lane] + b2 * x2[lane] - a2 * y2[lane]) - a1 * y1[lane]};
+				x2[lane] = x1[lane];
+				x1[lane] = x;
+				y2[lane] = y1[lane];
+				y1[lane] = y;
+				buffer[index + lane] = y;
+			}
+		auto Flush = [](float_type value) {return (std::abs(value) < Denormal) ? 0.0_flt : value;};
+		for (size_t lane {0}; lane < Lanes; lane++) {
+			state.x1[lane] = Flush(x1[lane]);
+			state.x2[lane] = Flush(x2[lane]);
+			state.y1[lane] = Flush(y1[lane]);
+			state.y2[lane] = Flush(y2[lane]);
+		}
+	}
+}
+
+template void BiquadCascade::Apply<1>(float_type*, size_t, State*) const;
+template void BiquadCascade::Apply<2>(float_type*, size_t, State*) const;
+
+template <size_t Lanes>
+void BiquadCascade::Run(music_type* data, size_t frames, std::vector<State>& states, bool write) const {
+	std::array<float_type, Block * Lanes> buffer;
+	for (size_t start {0}; start < frames; start += Block) {
+		const size_t count {std::min(Block, frames - start) * Lanes};
+		music_type* block {data + start * Lanes};
+		for (size_t index {0}; index < count; index++)
+			buffer[index] = static_cast<float_type>(block[index]) / PCMMax_f;
+		Apply<Lanes>(buffer.data(), count / Lanes, states.data());
+		if (write)
+			for (size_t index {0}; index < count; index++)
+				block[index] = static_cast<music_type>(std::clamp(buffer[index] * PCMMax_f, static_cast<float_type>(PCMMin), PCMMax_f));
+	}
+}
+
+template <size_t Lanes>
+void BiquadCascade::Glide(music_type* data, size_t frames, std::vector<State>& states, const BiquadCascade& target) const {
+	constexpr float_type Denormal {1e-30};
+	std::array<float_type, Block * Lanes> buffer;
+	const size_t count {frames * Lanes};
+	const float_type step {1.0_flt / static_cast<float_type>(frames)};
+	for (size_t index {0}; index < count; index++)
+		buffer[index] = static_cast<float_type>(data[index]) / PCMMax_f;
+	for (size_t section_index {0}; section_index < sections_.size(); section_index++) {
+		auto [b0, b1, b2, a1, a2] = sections_[section_index];
+		const Biquad& end {target.sections_[section_index]};
+		const float_type db0 {(end.b0 - b0) * step}, db1 {(end.b1 - b1) * step}, db2 {(end.b2 - b2) * step},
+			da1 {(end.a1 - a1) * step}, da2 {(end.a2 - a2) * step};
+		State& state {states[section_index]};
+		std::array<float_type, Lanes> x1, x2, y1, y2;
+		for (size_t lane {0}; lane < Lanes; lane++) {
+			x1[lane] = state.x1[lane];
+			x2[lane] = state.x2[lane];
+			y1[lane] = state.y1[lane];
+			y2[lane] = state.y2[lane];
+		}
+		for (size_t index {0}; index < count; index += Lanes) {
+			for (size_t lane {0}; lane < Lanes; lane++) {
+				const float_type x {buffer[index + lane]},
+					y {(b0 * x + b1 * x1[lane] + b2 * x2[lane] - a2 * y2[lane]) - a1 * y1[lane]};
+				x2[lane] = x1[lane];
+				x1[lane] = x;
+				y2[lane] = y1[lane];
+				y1[lane] = y;
+				buffer[index + lane] = y;
+			}
+			b0 += db0;
+			b1 += db1;
+			b2 += db2;
+			a1 += da1;
+			a2 += da2;
+		}
+		auto Flush = [](float_type value) {return (std::abs(value) < Denormal) ? 0.0_flt : value;};
+		for (size_t lane {0}; lane < Lanes; lane++) {
+			state.x1[lane] = Flush(x1[lane]);
+			state.x2[lane] = Flush(x2[lane]);
+			state.y1[lane] = Flush(y1[lane]);
+			state.y2[lane] = Flush(y2[lane]);
+		}
+	}
+	for (size_t index {0}; index < count; index++)
+		data[index] = static_cast<music_type>(std::clamp(buffer[index] * PCMMax_f, static_cast<float_type>(PCMMin), PCMMax_f));
+}
+
+void BiquadCascade::Process(MusicVector& music_data, int channels, size_t frames, bool circular) const {
+	if (sections_.empty())
+		return;
+	if (channels < 1)
+		throw EError("Biquad filters need at least one channel.");
+	if (std::cmp_greater(channels, MaxLanes)) {
+		EachChannel(music_data, channels, frames, [this, frames, circular](MusicVector& channel_data) {
+			Process(channel_data, 1, frames, circular);
+		});
+		return;
+	}
+	std::vector<State> states(sections_.size());
+	auto Pass = [this, channels, &states](music_type* data, size_t count, bool write) {
+		if (channels == 1)
+			Run<1>(data, count, states, write);
+		else
+			Run<2>(data, count, states, write);
+	};
+	if (circular) {
+		const size_t settle {std::min(Settle(), frames)};
+		Pass(music_data.data() + (frames - settle) * channels, settle, false);
+	}
+	Pass(music_data.data(), frames, true);
+}
+
+void BiquadCascade::Sweep(MusicVector& music_data, int channels, size_t frames,
+		const std::function<BiquadCascade(size_t)>& design, bool circular) {
+	if (channels < 1)
+		throw EError("Biquad filters need at least one channel.");
+	if (std::cmp_greater(channels, MaxLanes)) {
+		EachChannel(music_data, channels, frames, [frames, &design, circular](MusicVector& channel_data) {
+			Sweep(channel_data, 1, frames, design, circular);
+		});
+		return;
+	}
+	BiquadCascade current {design(0)};
+	std::vector<State> states(current.size());
+	if (circular) {
+		const BiquadCascade last {design(frames)};
+		if (last.size() != current.size())
+			throw EError("A filter sweep cannot change the number of filter sections.");
+		const size_t settle {std::min(last.Settle(), frames)};
+		music_type* tail {music_data.data() + (frames - settle) * channels};
+		if (channels == 1)
+			last.Run<1>(tail, settle, states, false);
+		else
+			last.Run<2>(tail, settle, states, false);
+	}
+	for (size_t start {0}; start < frames; start += Block) {
+		const size_t count {std::min(Block, frames - start)};
+		BiquadCascade next {design(start + count)};
+		if (next.size() != current.size())
+			throw EError("A filter sweep cannot change the number of filter sections.");
+		music_type* data {music_data.data() + start * channels};
+		if (channels == 1)
+			current.Glide<1>(data, count, states, next);
+		else
+			current.Glide<2>(data, count, states, next);
+		current = std::move(next);
+	}
+}
+
+} //end namespace BoxyLady
@@ -0,0 +1,85 @@
+//============================================================================
+// Name        : BoxyLady
+// Author      : Darren Green
+// Copyright   : (C) Darren Green 2011-2025
+// Description : Music sequencer
+//
+// License GPLv3+: GNU GPL version 3 or later <http://gnu.org/licenses/gpl.html>
+// This is free software; you are free to change and redistribute it.
+// There is NO WARRANTY, to the extent permitted by law.
+// Contact: darren.green@stir.ac.uk http://pinkmongoose.co.uk
+//============================================================================
+
+#ifndef BIQUAD_H_
+#define BIQUAD_H_
+
+#include <array>
+#include <functional>
+#include <vector>
+
+#include "Global.h"
+#include "Waveform.h"
+
+namespace BoxyLady {
+
+// One second-order section, normalised so that a0 = 1. Designs follow the
+// RBJ audio EQ cookbook; w0 is in radians per sample.
+
+struct Biquad {
+	float_type b0 {1.0}, b1 {0.0}, b2 {0.0}, a1 {0.0}, a2 {0.0};
+	static Biquad Normalise(float_type, float_type, float_type, float_type, float_type, float_type) noexcept;
+	static Biquad OnePoleLowPass(float_type) noexcept;
+	static Biquad OnePoleHighPass(float_type) noexcept;
+	static Biquad FirstOrderLowPass(float_type) noexcept;
+	static Biquad FirstOrderHighPass(float_type) noexcept;
+	static Biquad LowPass(float_type, float_type) noexcept;
+	static Biquad HighPass(float_type, float_type) noexcept;
+	static Biquad Peak(float_type, float_type, float_type) noexcept;
+	static Biquad Notch(float_type, float_type) noexcept;
+	static Biquad LowShelf(float_type, float_type, float_type) noexcept;
+	static Biquad HighShelf(float_type, float_type, float_type) noexcept;
+};
+
+class BiquadCascade {
+public:
+	static constexpr size_t Block {64}, MaxLanes {2};
+	struct State {
+		std::array<float_type, MaxLanes> x1 {}, x2 {}, y1 {}, y2 {};
+	};
+private:
+	std::vector<Biquad> sections_;
+	template <size_t Lanes>
+	void Run(music_type*, size_t, std::vector<State>&, bool) const;
+	template <size_t Lanes>
+	void Glide(music_type*, size_t, std::vector<State>&, const BiquadCascade&) const;
+public:
+	explicit BiquadCascade() = default;
+	explicit BiquadCascade(Biquad section) :
+		sections_{section} {}
+	BiquadCascade& Add(Biquad section) {
+		sections_.push_back(section);
+		return *this;
+	}
+	BiquadCascade& Add(const BiquadCascade& cascade) {
+		sections_.insert(sections_.end(), cascade.sections_.begin(), cascade.sections_.end());
+		return *this;
+	}
+	size_t size() const noexcept {return sections_.size();}
+	static BiquadCascade Butterworth(float_type, int, bool);
+	static BiquadCascade LinkwitzRiley(float_type, int, bool);
+	size_t Settle() const noexcept;
+	// Phase delay in samples at w radians per sample, summed over the sections.
+	float_type PhaseDelay(float_type) const noexcept;
+	// Filters interleaved float frames in place; one State per section.
+	template <size_t Lanes>
+	void Apply(float_type*, size_t, State*) const;
+	void Process(MusicVector&, int, size_t, bool = false) const;
+	// Time-varying filter: design(frame) is sampled every Block frames and the
+	// coefficients are interpolated per frame in between. Circular sweeps prime
+	// the state on the tail through the final design.
+	static void Sweep(MusicVector&, int, size_t, const std::function<BiquadCascade(size_t)>&, bool = false);
+};
+
+} //end namespace BoxyLady
+
+#endif /* BIQUAD_H_ */
@@ -10,42 +10,272 @@
 // Contact: darren.green@stir.ac.uk http://pinkmongoose.co.uk
 //============================================================================
 
-#include <set>
-#include <map>
+#include <array>
+#include <iterator>
+#include <algorithm>
+#include <mutex>
+#include <unordered_set>
 #include "Blob.h"
 
 namespace BoxyLady {
 
+class CharTable {
+public:
+	static constexpr unsigned char whitespace {1}, opener {2}, closer {4}, split {8}, automatic {16};
+private:
+	std::array<unsigned char, 256> flags_ {};
+	std::array<char, 256> matching_ {};
+	static constexpr size_t Index(char c) noexcept {
+		return static_cast<unsigned char>(c);
+	}
+public:
+	constexpr CharTable() noexcept {
+		for (int c {0}; c < 256; c++)
+			if ((c < 33) || (c >= 127))
+				flags_[c] = whitespace;
+		for (const auto& [open, close] : std::initializer_list<std::pair<char, char>> {
+			{'(',')'}, {'<','>'}, {'{','}'}, {'[',']'}, {'"','"'}, {ascii::STX, ascii::ETX}}) {
+			flags_[Index(open)] |= opener;
+			flags_[Index(close)] |= closer;
+			matching_[Index(open)] = close;
+		}
+		flags_[Index('=')] |= split;
+		flags_[Index('@')] |= automatic;
+	}
+	constexpr unsigned char operator[](char c) const noexcept {
+		return flags_[Index(c)];
+	}
+	constexpr char Matching(char c) const noexcept {
+		return matching_[Index(c)];
+	}
+};
+
+static constexpr CharTable char_table;
+
+class BlobReader {
+private:
+	std::string_view source_;
+	std::shared_ptr<const std::string> owner_;
+	size_t pos_ {0}, mark_ {0};
+	bool good_ {true};
+public:
+	explicit BlobReader(std::string_view source) noexcept :
+		source_{source} {}
+	explicit BlobReader(std::shared_ptr<const std::string> owner) noexcept :
+		source_{*owner}, owner_{owner} {}
+	bool good() const noexcept {
+		return good_;
+	}
+	const std::shared_ptr<const std::string>& owner() const noexcept {
+		return owner_;
+	}
+	char get() noexcept {
+		mark_ = pos_;
+		if (pos_ < source_.size())
+			return source_[pos_++];
+		good_ = false;
+		return ascii::ETX;
+	}
+	size_t next() const noexcept {
+		return pos_;
+	}
+	std::string_view Token(size_t start) const noexcept {
+		return source_.substr(start, mark_ - start);
+	}
+	void Skip(unsigned char flags) noexcept {
+		while ((pos_ < source_.size()) && (char_table[source_[pos_]] == flags))
+			pos_++;
+	}
+	std::string_view Literal() noexcept {
+		const size_t start {pos_};
+		while ((pos_ < source_.size()) && (source_[pos_] != '"') && (source_[pos_] != '\\'))
+			pos_++;
+		return source_.substr(start, pos_ - start);
+	}
+	bool SkipBlock(char opener) {
+		std::string closers(1, char_table.Matching(opener));
+		bool empty {true};
+		while (!closers.empty()) {
+			if (pos_ >= source_.size())
+				throw EError("Syntax error: unexpected end of file, expecting '" + std::string(1, closers.back()) + "'.");
+			const char c {source_[pos_++]};
+			if (c == closers.back()) {
+				closers.pop_back();
+				continue;
+			}
+			if (c == '"') {
+				while ((pos_ < source_.size()) && (source_[pos_] != '"'))
+					pos_ += (source_[pos_] == '\\') ? 2 : 1;
+				if (pos_ >= source_.size())
+					throw EError("Syntax error: unexpected end of file in a string literal.");
+				pos_++;
+				empty = false;
+			} else if (char_table[c] & CharTable::opener) {
+				closers.push_back(char_table.Matching(c));
+				empty = false;
+			} else if (char_table[c] & CharTable::closer)
+				throw EError("Syntax error: unexpected " + std::string(1, c) + " found before '" + GetABit() + "'.");
+			else if (!(char_table[c] & CharTable::whitespace))
+				empty = false;
+		}
+		return empty;
+	}
+	std::string GetABit() const {
+		const std::string_view bit {source_.substr(pos_, 15)};
+		return std::string {bit.substr(0, bit.find('\0'))};
+	}
+};
+
+class SymbolTable {
+private:
+	struct Hash {
+		using is_transparent = void;
+		size_t operator()(std::string_view name) const noexcept {
+			return std::hash<std::string_view>{}(name);
+		}
+	};
+	std::unordered_set<std::string, Hash, std::equal_to<>> names_;
+	std::mutex mutex_;
+	const std::string empty_ {};
+public:
+	const std::string* Intern(std::string_view name) {
+		if (name.empty())
+			return &empty_;
+		std::lock_guard lock {mutex_};
+		return &*names_.emplace(name).first;
+	}
+	const std::string* Lookup(std::string_view name) {
+		if (name.empty())
+			return &empty_;
+		std::lock_guard lock {mutex_};
+		const auto found {names_.find(name)};
+		return (found == names_.end()) ? nullptr : &*found;
+	}
+};
+
+static SymbolTable& symbol_table() {
+	static SymbolTable table;
+	return table;
+}
+
+const std::string* Symbol::Intern(std::string_view name) {
+	return symbol_table().Intern(name);
+}
+
+const std::string* Symbol::Lookup(std::string_view name) {
+	return symbol_table().Lookup(name);
+}
+
+void Blob::ChildList::BuildIndex() const {
+	const std::vector<Blob>& items {storage_->items_};
+	Index& index {*(storage_->index_ = std::make_unique<Index>())};
+	index.reserve(items.size());
+	for (size_t position {0}; position < items.size(); position++)
+		index.emplace_back(items[position].key_.id(), position);
+	std::ranges::sort(index, [](const auto& a, const auto& b) {
+		return std::less<const std::string*>{}(a.first, b.first) || ((a.first == b.first) && (a.second < b.second));
+	});
+	storage_->index_stale_ = storage_->lent_;
+}
+
+std::shared_ptr<Blob::ChildList::Storage> Blob::ChildList::Share() const {
+	if (storage_ && storage_->lent_)
+		return std::make_shared<Storage>(storage_->items_);
+	return storage_;
+}
+
+Blob::ChildList Blob::ChildList::Slice(size_t first, size_t last) const {
+	if ((first == 0) && (last == size()))
+		return *this;
+	ChildList slice;
+	slice.Append(*this, first, last);
+	return slice;
+}
+
+void Blob::ChildList::Append(const ChildList& other, size_t first, size_t last) {
+	if ((first > last) || (last > other.size()))
+		throw EError("Blob slice out of range.");
+	if (this == &other) {
+		const ChildList copy {other};
+		Append(copy, first, last);
+		return;
+	}
+	const std::vector<Blob>& source {other.items()};
+	std::vector<Blob>& items {Changed()};
+	items.insert(items.end(), source.begin() + static_cast<std::ptrdiff_t>(first), source.begin() + static_cast<std::ptrdiff_t>(last));
+}
+
+void Blob::ChildList::Recall() noexcept {
+	if (!storage_ || storage_->source_)
+		return;
+	storage_->lent_ = false;
+	for (Blob& child : storage_->items_)
+		child.children_.Recall();
+}
+
+std::optional<size_t> Blob::ChildList::Position(Symbol key) const {
+	const std::vector<Blob>& list {items()};
+	if (list.size() <= IndexThreshold) {
+		for (size_t position {0}; position < list.size(); position++)
+			if (list[position].key_ == key)
+				return position;
+		return std::nullopt;
+	}
+	auto& index {storage_->index_};
+	if (!index || (index->size() != list.size()))
+		BuildIndex();
+	const auto found {std::ranges::lower_bound(*index, key.id(), std::less<const std::string*>{},
+		[](const auto& entry) {return entry.first;})};
+	const bool hit {(found != index->end()) && (found->first == key.id())};
+	if (hit && (list[found->second].key_ == key))
+		return found->second;
+	if (!hit && !storage_->index_stale_)
+		return std::nullopt;
+	// The index may predate a key written through a lent reference, so a
+	// mismatch or an unverified miss is settled by a scan.
+	for (size_t position {0}; position < list.size(); position++)
+		if (list[position].key_ == key) {
+			index.reset();
+			return position;
+		}
+	if (hit)
+		index.reset();
+	return std::nullopt;
+}
+
+size_t Blob::ChildList::MemoryBytes() const {
+	if (!storage_)
+		return 0;
+	if (storage_->source_)
+		return sizeof(Storage) + storage_->source_->end - storage_->source_->start;
+	size_t bytes {sizeof(Storage) + (storage_->items_.capacity() - storage_->items_.size()) * sizeof(Blob)};
+	for (const Blob& child : storage_->items_)
+		bytes += child.MemoryBytes();
+	if (storage_->index_)
+		bytes += storage_->index_->capacity() * sizeof(Index::value_type);
+	return bytes;
+}
+
 bool Blob::isWhitespace(char c) const noexcept {
-	if (c < 33) return true;
-	else if (c == 127) return true;
-	else return false;
+	return char_table[c] & CharTable::whitespace;
 }
 
 char Blob::MatchingDelimiter(char c) const noexcept {
-	static std::map<char, char> delimiters {{'(',')'}, {'<','>'}, {'{','}'}, {'[',']'}, {'"','"'}, {ascii::STX, ascii::ETX}};
-	if (delimiters.contains(c)) return delimiters[c];
-	else return 0;
+	return char_table.Matching(c);
 }
 
 int Blob::DelimiterSign(char c) const noexcept {
-	const std::set<char> opener {'(','<','{','"',ascii::STX,'['}, closer {')','>','}','"',ascii::ETX,']'};
-	if (opener.contains(c)) return 1;
-	else if (closer.contains(c)) return -1;
+	if (char_table[c] & CharTable::opener) return 1;
+	else if (char_table[c] & CharTable::closer) return -1;
 	else return 0;
 }
 
 bool Blob::isAutoChar(char c) const noexcept {
-	switch (c) {
-	case '@': return true;
-	default: return false;
-	}
+	return char_table[c] & CharTable::automatic;
 }
 
 bool Blob::isTokenChar(char c) const noexcept {
-	if (isWhitespace(c)) return false;
-	else if (DelimiterSign(c)) return false;
-	else return true;
+	return !(char_table[c] & (CharTable::whitespace | CharTable::opener | CharTable::closer));
 }
 
 std::string Blob::DelimiterName(char c) const {
@@ -63,7 +293,7 @@ std::string Blob::DelimiterSymbol(char c) const {
 	}
 }
 
-Blob Blob::Wrap(char delimiter) {
+Blob Blob::Wrap(char delimiter) const {
 	Blob output(ascii::STX, "", ""), temp = *this;
 	temp.delimiter_ = delimiter;
 	output.children_.push_back(temp);
@@ -78,17 +308,53 @@ bool Blob::isAtomic() const {
 	if (children_.size() != 1)
 		return false;
 	const Blob& first = children_.front();
-	if (first.key_ != "")
+	if (!first.key_.empty())
 		return false;
 	return first.isAtomic();
 }
 
-std::string Blob::atom() const {
+const Blob& Blob::AtomNode() const {
 	if (!isAtomic())
 		throw EError("Syntax error: single value expected.\n" + ErrorString());
 	if (val_.length())
-		return val_;
-	return children_.front().atom();
+		return *this;
+	return children_.front().AtomNode();
+}
+
+const std::string& Blob::atom() const {
+	return AtomNode().val_;
+}
+
+Blob::NumericCache& Blob::Numeric() const {
+	if (const size_t hash {std::hash<std::string>{}(val_)}; numeric_.hash_ != hash) {
+		numeric_ = NumericCache {};
+		numeric_.hash_ = hash;
+	}
+	return numeric_;
+}
+
+std::optional<float_type> Blob::CachedFloat() const {
+	const Blob& node {AtomNode()};
+	NumericCache& numeric {node.Numeric()};
+	if (!numeric.float_known_) {
+		numeric.float_known_ = true;
+		try {
+			numeric.float_ = std::stod(node.val_);
+		} catch (const std::exception&) {}
+	}
+	return numeric.float_;
+}
+
+std::optional<int> Blob::CachedInt() const {
+	const Blob& node {AtomNode()};
+	NumericCache& numeric {node.Numeric()};
+	if (!numeric.int_known_) {
+		numeric.int_known_ = true;
+		try {
+			numeric.int_ = std::stoi(node.val_);
+		} catch (const std::exception&) {}
+	}
+	return numeric.int_;
 }
 
 bool Blob::isEmpty() const {
@@ -106,7 +372,7 @@ bool Blob::isBlock(bool no_key) const {
 		return false;
 	if (delimiter_ == '"')
 		return false;
-	if (children_.size())
+	if (!children_.empty())
 		return true;
 	return false;
 }
@@ -122,7 +388,7 @@ bool Blob::isToken() const {
 std::string Blob::Dump(std::string line_feed) const {
 	std::string out {""};
 	if (key_.length())
-		out += (key_ + "=");
+		out += (key_.str() + "=");
 	if (isAtomic()) {
 		out += ("'" + atom() + "' ");
 		return out;
@@ -149,21 +415,39 @@ std::string Blob::ErrorString() const {
 	return std::string("Problem in '") + DumpChunk() + std::string("'.");
 }
 
-std::string GetABit(std::istream &File) {
-	const std::streamsize n_chars {16};
-	char buffer[n_chars];
-	for (std::streamsize i {0}; i < n_chars; i++)
-		buffer[i] = 0;
-	File.read(buffer, n_chars - 1);
-	return buffer;
+size_t Blob::MemoryBytes() const {
+	return sizeof(Blob) + ((val_.capacity() > std::string{}.capacity()) ? val_.capacity() : 0)
+		+ children_.MemoryBytes();
 }
 
-void Blob::Parse(std::string input) {
-	std::istringstream buffer(input, std::istringstream::in);
-	Parse(buffer);
+void Blob::Parse(std::string_view input) {
+	BlobReader reader(input);
+	Parse(reader);
+	children_.Recall();
 }
 
 void Blob::Parse(std::istream &File) {
+	const std::string input {std::istreambuf_iterator<char>{File}, std::istreambuf_iterator<char>{}};
+	Parse(std::string_view{input});
+}
+
+void Blob::ParseLibrary(std::shared_ptr<const std::string> input) {
+	BlobReader reader(input);
+	Parse(reader);
+	children_.Recall();
+}
+
+void Blob::ChildList::Materialize() const {
+	const Source source {*storage_->source_};
+	Blob body {'('};
+	BlobReader reader(std::string_view{*source.text}.substr(source.start, source.end - source.start));
+	body.Parse(reader);
+	body.children_.Recall();
+	storage_->items_ = std::move(body.children_.Unshare());
+	storage_->source_.reset();
+}
+
+void Blob::Parse(BlobReader &File, size_t depth) {
 	enum class parse_mode {ready, scan1, scan2, literal};
 	using enum parse_mode;
 	parse_mode mode{ready};
@@ -171,101 +455,110 @@ void Blob::Parse(std::istream &File) {
 		mode = literal;
 	bool escape {false};
 	char c;
+	const char closing {MatchingDelimiter(delimiter_)};
+	size_t token {0};
 	std::string buffer {""};
 	Blob *child {nullptr};
+	auto ParseChild {[&File, depth, this](Blob& C) {
+		if (File.owner() && (depth == 1) && (key_ == "def") && (C.delimiter_ == '(') && !C.key_.empty()) {
+			const size_t start {File.next()};
+			const bool empty {File.SkipBlock(C.delimiter_)};
+			C.children_.Defer(Source {File.owner(), start, File.next(), empty});
+		} else
+			C.Parse(File, depth + 1);
+	}};
 	while (File.good()) {
 		c = File.get();
-		if (!File.good())
-			c = ascii::ETX;
 		switch (mode) {
 		case ready: // gap between items
-			if (c == MatchingDelimiter(delimiter_))
+			if (c == closing)
 				return;
 			if (isAutoChar(c)) {
 				child = &(AddChild(0, "", ""));
 				mode = scan2;
-				child->key_ = std::string(1, c);
+				token = File.next();
+				child->key_ = Symbol{std::string_view{&c, 1}};
 				continue;
 			}
 			if (DelimiterSign(c) < 0)
 				throw EError("Syntax error: unexpected "
 					+ DelimiterName(c) + " found before '"
-					+ GetABit(File) + "'.");
+					+ File.GetABit() + "'.");
 			if (DelimiterSign(c) > 0) {
 				Blob &C = AddChild(c, "", "");
-				C.Parse(File);
+				ParseChild(C);
 				continue;
 			}
-			if (isWhitespace(c))
+			if (isWhitespace(c)) {
+				File.Skip(CharTable::whitespace);
 				continue;
+			}
 			if (c == SplitChar)
-				throw EError("Syntax error: unexpected " + DelimiterName(c) + " found before '" + GetABit(File) + "'.");
+				throw EError("Syntax error: unexpected " + DelimiterName(c) + " found before '" + File.GetABit() + "'.");
 			child = &(AddChild(0, "", ""));
 			mode = scan1;
-			buffer += c;
+			token = File.next() - 1;
+			File.Skip(0);
 			continue;
 		case scan1: // prior to equals sign
-			if (c == MatchingDelimiter(delimiter_)) {
-				child->val_ = buffer;
+			if (c == closing) {
+				child->val_ = File.Token(token);
 				return;
 			}
 			if (DelimiterSign(c) < 0)
-				throw EError("Syntax error: unexpected " + DelimiterName(c) + " found before '" + GetABit(File) + "'.");
+				throw EError("Syntax error: unexpected " + DelimiterName(c) + " found before '" + File.GetABit() + "'.");
 			if (DelimiterSign(c) > 0) {
-				child->key_ = buffer;
-				buffer = "";
+				child->key_ = Symbol{File.Token(token)};
 				child->delimiter_ = c;
-				child->Parse(File);
+				ParseChild(*child);
 				mode = ready;
 				child = nullptr;
 				continue;
 			}
 			if (isWhitespace(c)) {
-				child->val_ = buffer;
-				buffer = "";
+				child->val_ = File.Token(token);
 				mode = ready;
 				child = nullptr;
 				continue;
 			}
 			if (c == SplitChar) {
-				child->key_ = buffer;
-				buffer = "";
+				child->key_ = Symbol{File.Token(token)};
+				token = File.next();
 				mode = scan2;
 				continue;
 			}
-			buffer += c;
+			File.Skip(0);
 			continue;
 		case scan2: // after equals sign
-			if (c == MatchingDelimiter(delimiter_)) {
-				child->val_ = buffer;
+			if (c == closing) {
+				child->val_ = File.Token(token);
 				return;
 			}
 			if (DelimiterSign(c) < 0)
-				throw EError("Syntax error: unexpected " + DelimiterName(c) + " found before '" + GetABit(File) + "'.");
+				throw EError("Syntax error: unexpected " + DelimiterName(c) + " found before '" + File.GetABit() + "'.");
 			if (DelimiterSign(c) > 0) {
-				if (buffer.length())
-					throw EError("Syntax error: unexpected " + DelimiterName(c) + " found before '" + GetABit(File) + "'.");
+				if (!File.Token(token).empty())
+					throw EError("Syntax error: unexpected " + DelimiterName(c) + " found before '" + File.GetABit() + "'.");
 				child->delimiter_ = c;
-				child->Parse(File);
+				ParseChild(*child);
 				mode = ready;
 				child = nullptr;
 				continue;
 			}
 			if (isWhitespace(c)) {
-				child->val_ = buffer;
-				buffer = "";
+				child->val_ = File.Token(token);
 				mode = ready;
 				child = nullptr;
 				continue;
 			}
 			if (c == SplitChar)
-				throw EError("Syntax error: unexpected " + DelimiterName(c) + " found before '" + GetABit(File) + "'.");
-			buffer += c;
+				throw EError("Syntax error: unexpected " + DelimiterName(c) + " found before '" + File.GetABit() + "'.");
+			File.Skip(0);
 			continue;
 		case literal: // for string literals
 			if (escape) {
 				escape = false;
-				if (c == MatchingDelimiter(delimiter_))
+				if (c == closing)
 					buffer += c;
 				else if (c == EscapeChar)
 					buffer += c;
@@ -274,17 +567,21 @@ void Blob::Parse(std::istream &File) {
 				else
 					throw EError("Unknown escape sequence: \\" + std::string(1, c) + ".");
 			} else {
-				if (c == MatchingDelimiter(delimiter_)) {
+				if (c == closing) {
 					val_ = buffer;
 					return;
 				} else if (c == EscapeChar)
 					escape = true;
-				else
+				else {
 					buffer += c;
+					buffer += File.Literal();
+				}
 			}
 			continue;
 		};
 	}
+	if (mode == literal)
+		throw EError("Syntax error: unexpected end of file in a string literal.");
 }
 
 } //end namespace BoxyLady
@@ -16,8 +16,12 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
+#include <memory>
+#include <optional>
+#include <utility>
 
 #include "Global.h"
 
@@ -27,10 +31,65 @@ namespace ascii {
 	inline constexpr unsigned char STX {2}, ETX {3};
 }
 
+class BlobReader;
+
+class Symbol {
+private:
+	const std::string* name_;
+	static const std::string* Intern(std::string_view);
+	static const std::string* Lookup(std::string_view);
+	explicit Symbol(const std::string* name) noexcept :
+		name_{name} {}
+public:
+	Symbol() :
+		Symbol{std::string_view{}} {}
+	explicit Symbol(std::string_view name) :
+		name_{Intern(name)} {}
+	static std::optional<Symbol> Find(std::string_view name) {
+		if (const auto found {Lookup(name)}) return Symbol{found};
+		else return std::nullopt;
+	}
+	const std::string& str() const noexcept {
+		return *name_;
+	}
+	operator const std::string&() const noexcept {
+		return *name_;
+	}
+	const std::string* id() const noexcept {
+		return name_;
+	}
+	size_t length() const noexcept {
+		return name_->length();
+	}
+	bool empty() const noexcept {
+		return name_->empty();
+	}
+	bool operator==(const Symbol& other) const noexcept {
+		return name_ == other.name_;
+	}
+	bool operator==(std::string_view other) const noexcept {
+		return *name_ == other;
+	}
+};
+
 class Blob {
 private:
 	static constexpr char EscapeChar {'\\'}, QuoteChar {'"'}, SplitChar {'='};
 	static constexpr std::string_view root {"?"};
+	// Conversions of val_, keyed on its hash so a write to val_ is noticed
+	// without keeping a copy. A failed conversion is cached as known but empty.
+	struct NumericCache {
+		size_t hash_ {0};
+		std::optional<float_type> float_ {};
+		std::optional<int> int_ {};
+		bool float_known_ {false}, int_known_ {false};
+	};
+	mutable NumericCache numeric_;
+	struct Source {
+		std::shared_ptr<const std::string> text;
+		size_t start {0}, end {0};
+		bool empty {true};
+	};
 	bool isWhitespace(char) const noexcept;
 	char MatchingDelimiter(char) const noexcept;
 	int DelimiterSign(char) const noexcept;
@@ -38,12 +97,184 @@ private:
 	bool isAutoChar(char) const noexcept;
 	std::string DelimiterName(char) const;
 	std::string DelimiterSymbol(char) const;
+	void Parse(BlobReader&, size_t = 0);
+	const Blob& AtomNode() const;
+	NumericCache& Numeric() const;
+	std::optional<float_type> CachedFloat() const;
+	std::optional<int> CachedInt() const;
+	std::optional<size_t> KeyIndex(std::string_view key) const {
+		if (const auto symbol {Symbol::Find(key)})
+			return children_.Position(*symbol);
+		return std::nullopt;
+	}
 public:
-	std::vector<Blob> children_;
-	std::string key_, val_;
+	// Children are shared copy-on-write between copies of a Blob, and any
+	// mutable access unshares one level first. A list that has handed out a
+	// mutable reference or iterator is copied eagerly instead, until Recall()
+	// (run once parsing, loading an image or running a macro is done), so
+	// writes through a reference held across a copy never reach the copy.
+	class ChildList {
+	private:
+		static constexpr size_t IndexThreshold {8};
+		using Index = std::vector<std::pair<const std::string*, size_t>>;
+		struct Storage {
+			std::vector<Blob> items_;
+			mutable std::unique_ptr<Index> index_;
+			std::optional<Source> source_;
+			bool lent_ {false};
+			mutable bool index_stale_ {false};
+			Storage() = default;
+			explicit Storage(const std::vector<Blob>& items) :
+				items_{items} {}
+		};
+		std::shared_ptr<Storage> storage_;
+		const std::vector<Blob>& items() const {
+			static const std::vector<Blob> empty;
+			if (!storage_)
+				return empty;
+			if (storage_->source_)
+				Materialize();
+			return storage_->items_;
+		}
+		void Materialize() const;
+		std::vector<Blob>& Unshare() {
+			items();
+			if (!storage_)
+				storage_ = std::make_shared<Storage>();
+			else if (storage_.use_count() > 1)
+				storage_ = std::make_shared<Storage>(storage_->items_);
+			return storage_->items_;
+		}
+		std::vector<Blob>& Changed() {
+			std::vector<Blob>& items {Unshare()};
+			storage_->index_.reset();
+			return items;
+		}
+		// A mutable reference or iterator into the list may still be held, so
+		// copies must not share it until Recall() says otherwise. The index is
+		// kept, but a key renamed through the reference can make it stale.
+		std::vector<Blob>& Lend() {
+			std::vector<Blob>& items {Unshare()};
+			storage_->lent_ = true;
+			if (storage_->index_)
+				storage_->index_stale_ = true;
+			return items;
+		}
+		void BuildIndex() const;
+		std::shared_ptr<Storage> Share() const;
+	public:
+		ChildList() = default;
+		ChildList(const ChildList& other) :
+			storage_{other.Share()} {}
+		ChildList(ChildList&&) noexcept = default;
+		ChildList& operator=(const ChildList& other) {
+			if (this != &other)
+				storage_ = other.Share();
+			return *this;
+		}
+		ChildList& operator=(ChildList&&) noexcept = default;
+		using iterator = std::vector<Blob>::iterator;
+		using const_iterator = std::vector<Blob>::const_iterator;
+		using reverse_iterator = std::vector<Blob>::reverse_iterator;
+		size_t size() const {
+			return items().size();
+		}
+		bool empty() const {
+			if (storage_ && storage_->source_)
+				return storage_->source_->empty;
+			return items().empty();
+		}
+		const_iterator begin() const {
+			return items().begin();
+		}
+		const_iterator end() const {
+			return items().end();
+		}
+		iterator begin() {
+			return Lend().begin();
+		}
+		iterator end() {
+			return Lend().end();
+		}
+		reverse_iterator rbegin() {
+			return Lend().rbegin();
+		}
+		reverse_iterator rend() {
+			return Lend().rend();
+		}
+		Blob& front() {
+			return Lend().front();
+		}
+		const Blob& front() const {
+			return items().front();
+		}
+		Blob& back() {
+			return Lend().back();
+		}
+		const Blob& back() const {
+			return items().back();
+		}
+		Blob& operator[](size_t index) {
+			return Lend()[index];
+		}
+		const Blob& operator[](size_t index) const {
+			return items()[index];
+		}
+		Blob& at(size_t index) {
+			return Lend().at(index);
+		}
+		const Blob& at(size_t index) const {
+			return items().at(index);
+		}
+		void push_back(const Blob& blob) {
+			Changed().push_back(blob);
+		}
+		void push_back(Blob&& blob) {
+			Changed().push_back(std::move(blob));
+		}
+		iterator erase(const_iterator first, const_iterator last) {
+			return Changed().erase(first, last);
+		}
+		void resize(size_t count) {
+			Changed().resize(count);
+		}
+		void clear() {
+			if (storage_.use_count() > 1)
+				storage_.reset();
+			else if (storage_)
+				Changed().clear();
+		}
+		bool isShared() const noexcept {
+			return storage_.use_count() > 1;
+		}
+		bool isDeferred() const noexcept {
+			return storage_ && storage_->source_;
+		}
+		// The unparsed source of a deferred list, including its closing delimiter.
+		std::string_view DeferredText() const noexcept {
+			if (!isDeferred())
+				return {};
+			const Source& source {*storage_->source_};
+			return std::string_view {*source.text}.substr(source.start, source.end - source.start);
+		}
+		void Defer(Source source) {
+			storage_ = std::make_shared<Storage>();
+			storage_->source_ = std::move(source);
+		}
+		// Slices copy only the outer list; each child's own subtree is shared.
+		ChildList Slice(size_t, size_t) const;
+		void Append(const ChildList&, size_t, size_t);
+		void Recall() noexcept;
+		std::optional<size_t> Position(Symbol) const;
+		size_t MemoryBytes() const;
+	};
+	ChildList children_;
+	Symbol key_;
+	std::string val_;
 	char delimiter_;
 	void Parse(std::istream&);
-	void Parse(std::string);
+	void Parse(std::string_view);
+	void ParseLibrary(std::shared_ptr<const std::string>);
 	explicit Blob(char delimiter = ascii::STX, std::string val = "", std::string key = std::string{root}) :
 		key_{key}, val_{val}, delimiter_{delimiter} {}
 	explicit Blob(std::string input, char delimiter = ascii::STX, std::string val = "", std::string key = std::string{root}) :
@@ -54,33 +285,30 @@ public:
 		children_.push_back(Blob(delimiter, val, key));
 		return children_.back();
 	}
-	Blob Wrap(char);
-	bool hasKey(std::string key) const {
-		for (auto& child : children_)
-			if (child.key_ == key)
-				return true;
-		return false;
+	Blob Wrap(char) const;
+	bool hasKey(std::string_view key) const {
+		return KeyIndex(key).has_value();
 	}
-	Blob& operator[](std::string key) {
-		for (auto& child : children_)
-			if (child.key_ == key)
-				return child;
-		throw EError("Syntax error: missing value '" + key + "'.\n" + ErrorString());
+	Blob& operator[](std::string_view key) {
+		if (const auto index {KeyIndex(key)})
+			return children_[*index];
+		throw EError("Syntax error: missing value '" + std::string{key} + "'.\n" + ErrorString());
 	}
 	Blob& operator[](size_t index) {
 		if (index > children_.size() - 1)
 			throw EError("Syntax error: missing value.\n" + ErrorString());
 		return children_[index];
 	}
-	bool hasFlag(std::string key) const {
+	bool hasFlag(std::string_view key) const {
 		for (auto& child : children_)
-			if ((child.key_ == "") && (child.val_ == key))
+			if ((child.key_.empty()) && (child.val_ == key))
 				return true;
 		return false;
 	}
 	std::string Dump(std::string = "\n") const;
 	std::string DumpChunk(size_t = 25, size_t = 10) const;
 	std::string ErrorString() const;
+	size_t MemoryBytes() const;
 	bool isAtomic() const;
 	bool isEmpty() const;
 	bool isBlock(bool = true) const;
@@ -96,26 +324,22 @@ public:
 	void AssertFunction() {
 		ifFunction();
 	}
-	std::string atom() const;
+	const std::string& atom() const;
 	int asInt(int low = int_min, int high = int_max) const {
-		int result {0};
-		try {
-        	result = std::stoi(atom());
-		} catch (const std::exception& e) {
+		const auto value {CachedInt()};
+		if (!value)
 			throw EError("Syntax error: integer expected.\n" + ErrorString());
-		}
+		const int result {*value};
 		if ((result < low) || (result > high))
 			throw EError("Integer out of range.\n" + ErrorString());
 		else
 			return result;
 	}
 	float_type asFloat(float_type low = -float_type_max, float_type high = float_type_max) const {
-		float_type result {0};
-		try {
-        	result = std::stod(atom());
-		} catch (const std::exception& e) {
+		const auto value {CachedFloat()};
+		if (!value)
 			throw EError("Syntax error: float expected.\n" + ErrorString());
-		}
+		const float_type result {*value};
 		if ((result < low) || (result > high))
 			throw EError("Floating point number out of range.\n" + ErrorString());
 		else
@@ -123,33 +347,33 @@ public:
 	}
 	bool asBool() const {
 		static const std::map<std::string_view, bool> bool_map {{"TRUE",true}, {"T",true}, {"true",true}, {"FALSE",false}, {"F",false}, {"false",false}};
-		if (const auto string_value = atom(); bool_map.contains(string_value)) return bool_map.at(string_value);
+		if (const auto found {bool_map.find(atom())}; found != bool_map.end()) return found->second;
 		else throw EError("Syntax error: boolean expected.\n" + ErrorString());
 	}
-	bool tryWriteInt(std::string lookup_key, int& value, int low = int_min, int high = int_max) {
-		if (hasKey(lookup_key)) {
-			value = operator[](lookup_key).asInt(low, high);
+	bool tryWriteInt(std::string_view lookup_key, int& value, int low = int_min, int high = int_max) {
+		if (const auto index {KeyIndex(lookup_key)}) {
+			value = std::as_const(children_)[*index].asInt(low, high);
 			return true;
 		} else
 			return false;
 	}
-	bool tryWritefloat_type(std::string lookup_key, float_type& value, float_type low = -float_type_max, float_type high = float_type_max) {
-		if (hasKey(lookup_key)) {
-			value = operator[](lookup_key).asFloat(low, high);
+	bool tryWritefloat_type(std::string_view lookup_key, float_type& value, float_type low = -float_type_max, float_type high = float_type_max) {
+		if (const auto index {KeyIndex(lookup_key)}) {
+			value = std::as_const(children_)[*index].asFloat(low, high);
 			return true;
 		} else
 			return false;
 	}
-	bool tryWriteBool(std::string lookup_key, bool &value) {
-		if (hasKey(lookup_key)) {
-			value = operator[](lookup_key).asBool();
+	bool tryWriteBool(std::string_view lookup_key, bool &value) {
+		if (const auto index {KeyIndex(lookup_key)}) {
+			value = std::as_const(children_)[*index].asBool();
 			return true;
 		} else
 			return false;
 	}
-	bool tryWriteString(std::string lookup_key, std::string &value) {
-		if (hasKey(lookup_key)) {
-			value = operator[](lookup_key).atom();
+	bool tryWriteString(std::string_view lookup_key, std::string &value) {
+		if (const auto index {KeyIndex(lookup_key)}) {
+			value = std::as_const(children_)[*index].atom();
 			return true;
 		} else
 			return false;
@@ -0,0 +1,94 @@
+//============================================================================
+// Name        : BoxyLady
+// Author      : Darren Green
+// Copyright   : (C) Darren Green 2011-2025
+// Description : Music sequencer
+//
+// License GPLv3+: GNU GPL version 3 or later <http://gnu.org/licenses/gpl.html>
+// This is free software; you are free to change and redistribute it.
+// There is NO WARRANTY, to the extent permitted by law.
+// Contact: darren.green@stir.ac.uk http://pinkmongoose.co.uk
+//============================================================================
+
+#include <algorithm>
+#include <bit>
+
+#include "Convolution.h"
+#include "Parallel.h"
+
+namespace BoxyLady {
+
+Convolver::Convolver(const Samples& impulse, size_t block) :
+		block_{block} {
+	if (!std::has_single_bit(block_))
+		throw EError("Convolution block size must be a power of 2.");
+	for (size_t start {0}; start < impulse.size(); start += block_) {
+		Fourier::ComplexVector spectrum(block_ * 2);
+		const size_t stop {std::min(start + block_, impulse.size())};
+		for (size_t index {start}; index < stop; index++)
+			spectrum[index - start] = impulse[index];
+		Fourier::FFT(spectrum, false);
+		spectra_.push_back(std::move(spectrum));
+	}
+}
+
+size_t Convolver::DefaultBlock(size_t impulse_length) noexcept {
+	return std::bit_ceil(std::clamp<size_t>(impulse_length / 8, 64, 16384));
+}
+
+Convolver::Samples Convolver::Process(const Samples& input, size_t length, size_t threads) const {
+	Samples output(length, 0.0);
+	if (spectra_.empty() || !length)
+		return output;
+	const size_t size {block_ * 2}, partitions {spectra_.size()}, blocks {(length + block_ - 1) / block_},
+		slots {partitions + Batch - 1};
+	threads = std::clamp<size_t>(threads, 1, Batch);
+	// Block b's input spectrum lives in slot b % slots until the last partition has used it.
+	std::vector<Fourier::ComplexVector> history(std::min(slots, blocks), Fourier::ComplexVector(size));
+	auto Sample = [&input](size_t index) {
+		return (index < input.size()) ? input[index] : 0.0_flt;
+	};
+	for (size_t first {0}; first < blocks; first += Batch) {
+		const size_t last {std::min(blocks, first + Batch)};
+		ParallelFor(last - first, threads, [&, first](size_t offset) {
+			const size_t block {first + offset};
+			Fourier::ComplexVector& spectrum {history[block % slots]};
+			for (size_t index {0}; index < size; index++)
+				spectrum[index] = (block * block_ + index >= block_) ? Sample(block * block_ + index - block_) : 0.0_flt;
+			Fourier::FFT(spectrum, false);
+		});
+		ParallelFor(threads, threads, [&, first, last](size_t thread) {
+			Fourier::ComplexVector frame(size);
+			for (size_t block {first + thread}; block < last; block += threads) {
+				std::fill(frame.begin(), frame.end(), Fourier::Complex {0.0});
+				for (size_t partition {0}; (partition < partitions) && (partition <= block); partition++) {
+					const Fourier::ComplexVector& input_spectrum {history[(block - partition) % slots]},
+						&impulse_spectrum {spectra_[partition]};
+					for (size_t index {0}; index <= block_; index++)
+						frame[index] += input_spectrum[index] * impulse_spectrum[index];
+				}
+				for (size_t index {1}; index < block_; index++)
+					frame[size - index] = std::conj(frame[index]);
+				Fourier::FFT(frame, true);
+				const size_t stop {std::min(block_, length - block * block_)};
+				for (size_t index {0}; index < stop; index++)
+					output[block * block_ + index] = frame[block_ + index].real();
+			}
+		});
+	}
+	return output;
+}
+
+Convolver::Samples Convolver::Direct(const Samples& impulse, const Samples& input, size_t length) {
+	Samples output(length, 0.0);
+	for (size_t index {0}; index < length; index++) {
+		float_type sum {0.0};
+		const size_t stop {std::min(impulse.size(), index + 1)};
+		for (size_t tap {(index >= input.size()) ? index - input.size() + 1 : 0}; tap < stop; tap++)
+			sum += impulse[tap] * input[index - tap];
+		output[index] = sum;
+	}
+	return output;
+}
+
+} //end namespace BoxyLady
@@ -0,0 +1,48 @@
+//============================================================================
+// Name        : BoxyLady
+// Author      : Darren Green
+// Copyright   : (C) Darren Green 2011-2025
+// Description : Music sequencer
+//
+// License GPLv3+: GNU GPL version 3 or later <http://gnu.org/licenses/gpl.html>
+// This is free software; you are free to change and redistribute it.
+// There is NO WARRANTY, to the extent permitted by law.
+// Contact: darren.green@stir.ac.uk http://pinkmongoose.co.uk
+//============================================================================
+
+#ifndef CONVOLUTION_H_
+#define CONVOLUTION_H_
+
+#include <vector>
+
+#include "Global.h"
+#include "Fourier.h"
+
+namespace BoxyLady {
+
+// Uniformly partitioned overlap-save convolution. The impulse response is cut
+// into blocks of `block_` samples, each held as a spectrum of twice that size;
+// every input block costs one forward and one inverse FFT plus a
+// multiply-accumulate per partition. Input is taken in batches of blocks:
+// threads share out the forward transforms, then the output blocks, each
+// reading the batch's spectra from a common history.
+
+class Convolver {
+public:
+	using Samples = std::vector<float_type>;
+private:
+	static constexpr size_t Batch {64};
+	size_t block_;
+	std::vector<Fourier::ComplexVector> spectra_;
+public:
+	explicit Convolver(const Samples&, size_t);
+	size_t block() const noexcept {return block_;}
+	size_t partitions() const noexcept {return spectra_.size();}
+	Samples Process(const Samples&, size_t, size_t = 1) const;
+	static Samples Direct(const Samples&, const Samples&, size_t);
+	static size_t DefaultBlock(size_t) noexcept;
+};
+
+} //end namespace BoxyLady
+
+#endif /* CONVOLUTION_H_ */
@@ -0,0 +1,82 @@
+//============================================================================
+// Name        : BoxyLady
+// Author      : Darren Green
+// Copyright   : (C) Darren Green 2011-2025
+// Description : Music sequencer
+//
+// License GPLv3+: GNU GPL version 3 or later <http://gnu.org/licenses/gpl.html>
+// This is free software; you are free to change and redistribute it.
+// There is NO WARRANTY, to the extent permitted by law.
+// Contact: darren.green@stir.ac.uk http://pinkmongoose.co.uk
+//============================================================================
+
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <vector>
+
+#include "Delay.h"
+
+namespace BoxyLady {
+
+FeedbackDelay::FeedbackDelay(float_type delay, float_type amp, const FilterChain& chain, bool pingpong) :
+		delay_{delay}, amp_{amp}, chain_{chain}, pingpong_{pingpong} {
+	if (delay_ < 1.0_flt)
+		throw EError("Echo delay must be at least one sample.");
+	if (!chain_.isStreaming())
+		throw EError("Feedback echo: Fourier, pitch_scale, and ks:reverse filters cannot go in the feedback loop.");
+}
+
+template <size_t Lanes>
+void FeedbackDelay::Run(MusicVector& music_data, size_t frames) const {
+	const size_t whole {static_cast<size_t>(delay_)}, block {std::min(Block, whole)},
+		mask {std::bit_ceil(whole + 2) - 1};
+	const float_type fraction {delay_ - static_cast<float_type>(whole)};
+	std::vector<float_type> line((mask + 1) * Lanes, 0.0);
+	auto Line = [&line, mask](size_t position, size_t lane) -> float_type& {
+		return line[(position & mask) * Lanes + lane];
+	};
+	std::array<float_type, Block * Lanes> buffer;
+	std::vector<FilterChain::Memory> memory {chain_.Start()};
+	for (size_t start {0}; start < frames; start += block) {
+		const size_t count {std::min(block, frames - start)};
+		for (size_t frame {0}; frame < count; frame++) {
+			const size_t position {start + frame};
+			for (size_t lane {0}; lane < Lanes; lane++) {
+				const size_t source {pingpong_ ? Lanes - 1 - lane : lane};
+				float_type value {0.0};
+				if (position >= whole)
+					value += (1.0_flt - fraction) * Line(position - whole, source);
+				if (position > whole)
+					value += fraction * Line(position - whole - 1, source);
+				buffer[frame * Lanes + lane] = value;
+			}
+		}
+		chain_.Stream<Lanes>(buffer.data(), count, memory);
+		for (size_t frame {0}; frame < count; frame++) {
+			music_type* samples {&music_data[(start + frame) * Lanes]};
+			float_type mid {0.0};
+			for (size_t lane {0}; lane < Lanes; lane++)
+				mid += static_cast<float_type>(samples[lane]) / PCMMax_f / static_cast<float_type>(Lanes);
+			for (size_t lane {0}; lane < Lanes; lane++) {
+				const float_type dry {static_cast<float_type>(samples[lane]) / PCMMax_f},
+					echo {amp_ * buffer[frame * Lanes + lane]},
+					input {pingpong_ ? ((lane == 0) ? mid : 0.0_flt) : dry};
+				Line(start + frame, lane) = std::clamp(input + echo, -1.0_flt, 1.0_flt);
+				samples[lane] = static_cast<music_type>(std::clamp((dry + echo) * PCMMax_f, static_cast<float_type>(PCMMin), PCMMax_f));
+			}
+		}
+	}
+}
+
+void FeedbackDelay::Process(MusicVector& music_data, int channels, size_t frames) const {
+	if (channels == 1)
+		Run<1>(music_data, frames);
+	else if (channels == 2)
+		Run<2>(music_data, frames);
+	else
+		throw EError("Feedback echo only works on 1-2 channels.");
+}
+
+} //end namespace BoxyLady
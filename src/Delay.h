@@ -0,0 +1,44 @@
+//============================================================================
+// Name        : BoxyLady
+// Author      : Darren Green
+// Copyright   : (C) Darren Green 2011-2025
+// Description : Music sequencer
+//
+// License GPLv3+: GNU GPL version 3 or later <http://gnu.org/licenses/gpl.html>
+// This is free software; you are free to change and redistribute it.
+// There is NO WARRANTY, to the extent permitted by law.
+// Contact: darren.green@stir.ac.uk http://pinkmongoose.co.uk
+//============================================================================
+
+
+#ifndef DELAY_H_
+#define DELAY_H_
+
+#include "Global.h"
+#include "Waveform.h"
+#include "FilterChain.h"
+
+namespace BoxyLady {
+
+// Streaming feedback echo. The line is read `delay_` frames back, with linear
+// interpolation for the fractional part, passed through the filter chain,
+// scaled by `amp_` and fed back in, so any number of repeats costs one pass.
+// Ping-pong feeds the mid signal into the left line and crosses the channels
+// on every trip round the loop.
+
+class FeedbackDelay {
+private:
+	static constexpr size_t Block {256};
+	float_type delay_, amp_;
+	const FilterChain& chain_;
+	bool pingpong_;
+	template <size_t Lanes>
+	void Run(MusicVector&, size_t) const;
+public:
+	explicit FeedbackDelay(float_type, float_type, const FilterChain&, bool);
+	void Process(MusicVector&, int, size_t) const;
+};
+
+} //end namespace BoxyLady
+
+#endif /* DELAY_H_ */
@@ -11,12 +11,15 @@
 //============================================================================
 
 #include <map>
+#include <algorithm>
+#include <cctype>
 
 #include "Dictionary.h"
+#include "Memory.h"
 
 namespace BoxyLady {
 
-bool DictionaryItem::ValidName(std::string name) {
+bool DictionaryItem::ValidName(std::string_view name) {
 	constexpr std::string_view valid {":._-"};
 	if (name.empty())
 		return false;
@@ -51,6 +54,106 @@ void Dictionary::WriteSlotProtection(std::string& block, dic_item_protection lev
 	SWrite(block, levels.at(level), 67);
 }
 
+std::vector<ImagePage> Dictionary::WriteImageSamples(ImageWriter& image) const {
+	std::vector<ImagePage> pages;
+	ForEachSlot([&pages, &image](const Slot& slot) {
+		if (slot.item_.isSound())
+			pages.push_back(slot.item_.sound_.WriteImageSamples(image));
+	});
+	return pages;
+}
+
+void Dictionary::WriteImageIndex(ImageWriter& image, const std::vector<ImagePage>& pages) const {
+	auto page {pages.begin()};
+	image.Write(static_cast<uint32_t>(index_.size()));
+	ForEachSlot([&page, &image](const Slot& slot) {
+		const DictionaryItem& item {slot.item_};
+		image.WriteString(slot.name_.str());
+		image.Write(static_cast<uint8_t>(item.type_));
+		image.Write(static_cast<uint8_t>(item.protection_level_));
+		image.Write(static_cast<uint8_t>(item.macro_type_));
+		if (item.isSound())
+			item.sound_.WriteImageHeader(image, *page++);
+		else
+			image.WriteBlob(item.macro_);
+	});
+}
+
+void Dictionary::ReadImage(ImageReader& image) {
+	for (uint32_t count {image.Read<uint32_t>()}; count > 0; count--) {
+		const std::string name {image.ReadString()};
+		DictionaryItem item {static_cast<dic_item_type>(image.Read<uint8_t>())};
+		item.protection_level_ = static_cast<dic_item_protection>(image.Read<uint8_t>());
+		item.macro_type_ = static_cast<macro_type>(image.Read<uint8_t>());
+		if (item.isSound())
+			item.sound_.ReadImage(image);
+		else
+			image.ReadBlob(item.macro_);
+		if (!contains(name))
+			Insert(std::move(item), name);
+	}
+}
+
+// Moves in each item of `other` whose name is not already taken here.
+void Dictionary::Merge(Dictionary&& other) {
+	other.ForEachSlot([this](Slot& slot) {
+		if (!contains(slot.name_.str()))
+			Insert(std::move(slot.item_), slot.name_.str());
+	});
+}
+
+size_t Dictionary::ResidentBytes() const {
+	size_t bytes {0};
+	for (const size_t position : sound_slots_)
+		bytes += slots_[position].item_.sound_.ResidentBytes();
+	return bytes;
+}
+
+size_t Dictionary::SlackBytes() const {
+	size_t bytes {0};
+	for (const size_t position : sound_slots_)
+		bytes += slots_[position].item_.sound_.SlackBytes();
+	return bytes;
+}
+
+size_t Dictionary::MacroBytes() const {
+	size_t bytes {0};
+	ForEachSlot([&bytes](const Slot& slot) {
+		if (slot.item_.isMacro())
+			bytes += slot.item_.macro_.MemoryBytes();
+	});
+	return bytes;
+}
+
+size_t Dictionary::PagedOut() const {
+	return std::ranges::count_if(sound_slots_, [this](size_t position) {
+		return !slots_[position].item_.sound_.isResident();
+	});
+}
+
+void Dictionary::Spill(size_t limit) {
+	// Every resident sample buffer is counted by MemoryStats, so its running
+	// total bounds ResidentBytes() without walking the Sounds.
+	if (MemoryStats::current() <= limit)
+		return;
+	size_t bytes {ResidentBytes()};
+	if (bytes <= limit)
+		return;
+	std::vector<Slot*> candidates;
+	for (const size_t position : sound_slots_)
+		if (Slot& slot {slots_[position]}; (slot.item_.semaphor_ == 0)
+				&& (slot.item_.protection_level_ < dic_item_protection::locked)
+				&& slot.item_.sound_.ResidentBytes())
+			candidates.push_back(&slot);
+	std::ranges::sort(candidates, {}, &Slot::last_use_);
+	for (Slot* slot : candidates) {
+		if (bytes <= limit)
+			break;
+		bytes -= slot->item_.sound_.ResidentBytes();
+		slot->item_.sound_.PageOut();
+	}
+}
+
 void Dictionary::ListEntries(Blob& Q) {
 	const bool all {Q.hasFlag("*")};
 	const std::array<std::string, 5> dictionary_types { { "unknown", "deleted", "sound", "macro", "instr." } };
@@ -68,14 +171,17 @@ void Dictionary::ListEntries(Blob& Q) {
 	screen.PrintSeparatorTop();
 	screen.Print(title + "\n");
 	screen.PrintSeparatorMid();
-	for (auto& map_item : dictionary_) {
-		DictionaryItem& dictionary_item {map_item.second};
+	std::vector<Slot*> entries;
+	ForEachSlot([&entries](Slot& slot) {entries.push_back(&slot);});
+	std::ranges::sort(entries, {}, [](const Slot* slot) -> const std::string& {return slot->name_.str();});
+	for (Slot* slot : entries) {
+		DictionaryItem& dictionary_item {slot->item_};
 		if (!all)
 			if (dictionary_item.protection_level_ == dic_item_protection::system)
 				continue;
 		Sound& sound {dictionary_item.sound_};
 		std::string block {display};
-		SWrite(block, map_item.first, 1);
+		SWrite(block, slot->name_.str(), 1);
 		if (dictionary_item.isSound()) {
 			const SampleType sample_type {sound.getType()};
 			SWrite(block, float_type(sound.sample_rate()) / 1000, 16);
@@ -89,15 +195,26 @@ void Dictionary::ListEntries(Blob& Q) {
 				SWrite(block, "i", 65);
 			if (sample_type.start_anywhere)
 				SWrite(block, "A", 66);
+			if (!sound.isResident())
+				SWrite(block, "D", 64);
 			SWrite(block, sound.MusicDataSize(), 72);
 		} else if (dictionary_item.isMacro()) {
 			if (dictionary_item.getMacroType() == macro_type::variable)
 				SWrite(block, "v", 64);
-			if (dictionary_item.getMacro().children_.size() > 0)
-				SWrite(block, dictionary_item.getMacro()[0].DumpChunk(32, 14), 16);
-			SWrite(block, dictionary_item.getMacro().Dump().length(), 72);
+			// Deferred library definitions are listed from their source text, unparsed.
+			if (const Blob& macro {dictionary_item.getMacro()}; macro.children_.isDeferred()) {
+				std::string text {macro.children_.DeferredText()};
+				text.pop_back();
+				std::ranges::replace_if(text, [](char c) {return std::isspace(static_cast<unsigned char>(c));}, ' ');
+				SWrite(block, (text.length() < 32) ? text : text.substr(0, 14) + " ... " + text.substr(text.length() - 14), 16);
+				SWrite(block, text.length(), 72);
+			} else {
+				if (macro.children_.size() > 0)
+					SWrite(block, macro.children_[0].DumpChunk(32, 14), 16);
+				SWrite(block, macro.Dump().length(), 72);
+			}
 		} else {
-			SWrite(block, map_item.first, 4);
+			SWrite(block, slot->name_.str(), 4);
 		}
 		SWrite(block, dictionary_types[static_cast<size_t>(dictionary_item.getType())], 54);
 		WriteSlotProtection(block, dictionary_item.ProtectionLevel());
@@ -107,4 +224,54 @@ void Dictionary::ListEntries(Blob& Q) {
 	screen.PrintSeparatorBot();
 }
 
+void Dictionary::ListMemory(bool all) {
+	std::string display {std::string(screen.Width, ' ')}, title {display};
+	SWrite(title, "Slot name", 1);
+	SWrite(title, "Ch.", 16);
+	SWrite(title, "Alloc. fr.", 21);
+	SWrite(title, "Used fr.", 33);
+	SWrite(title, "Alloc. Mb", 45);
+	SWrite(title, "Used Mb", 56);
+	SWrite(title, "Flags", 64);
+	SWrite(title, "Blob b", 72);
+	title += screen.Tab(1) + "│" + screen.Tab(screen.Width) + "│";
+	screen.PrintSeparatorTop();
+	screen.Print(title + "\n");
+	screen.PrintSeparatorMid();
+	std::vector<const Slot*> entries;
+	ForEachSlot([&entries](const Slot& slot) {entries.push_back(&slot);});
+	std::ranges::sort(entries, {}, [](const Slot* slot) -> const std::string& {return slot->name_.str();});
+	for (const Slot* slot : entries) {
+		const DictionaryItem& dictionary_item {slot->item_};
+		if (!all)
+			if (dictionary_item.protection_level_ == dic_item_protection::system)
+				continue;
+		if (!dictionary_item.isSound() && !dictionary_item.isMacro())
+			continue;
+		std::string block {display};
+		SWrite(block, slot->name_.str(), 1);
+		if (dictionary_item.isSound()) {
+			const Sound& sound {dictionary_item.sound_};
+			const size_t channels {static_cast<size_t>(std::max(sound.channels(), 1))},
+				allocated {sound.ResidentBytes() / sizeof(music_type)};
+			SWrite(block, sound.channels(), 16);
+			SWrite(block, allocated / channels, 21);
+			SWrite(block, sound.p_samples(), 33);
+			SWrite(block, static_cast<float_type>(sound.ResidentBytes()) / MegaByte, 45);
+			SWrite(block, static_cast<float_type>(sound.p_samples() * channels * sizeof(music_type)) / MegaByte, 56);
+			if (!sound.isResident())
+				SWrite(block, "D", 64);
+			else if (sound.SlackBytes())
+				SWrite(block, "s", 64);
+		} else {
+			if (dictionary_item.macro_.children_.isDeferred())
+				SWrite(block, "l", 65);
+			SWrite(block, dictionary_item.macro_.MemoryBytes(), 72);
+		}
+		block += screen.Tab(1) + "│" + screen.Tab(screen.Width) + "│";
+		screen.Print(block + "\n");
+	}
+	screen.PrintSeparatorBot();
+}
+
 } //end namespace BoxyLady
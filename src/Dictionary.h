@@ -13,8 +13,10 @@
 #ifndef DICTIONARY_H_
 #define DICTIONARY_H_
 
-#include <map>
+#include <deque>
+#include <set>
 #include <functional>
+#include <unordered_map>
 
 #include "Global.h"
 #include "Sound.h"
@@ -51,6 +53,10 @@ public:
 			semaphor_{0}, type_{type},
 			protection_level_{dic_item_protection::normal},
 			macro_type_{macro_type::null} {}
+	DictionaryItem(const DictionaryItem&) = delete;
+	DictionaryItem& operator=(const DictionaryItem&) = delete;
+	DictionaryItem(DictionaryItem&&) = default;
+	DictionaryItem& operator=(DictionaryItem&&) = default;
 	dic_item_protection ProtectionLevel() const noexcept {
 		return protection_level_;
 	}
@@ -73,7 +79,7 @@ public:
 	macro_type& getMacroType() noexcept {return macro_type_;}
 	Blob& getMacro() {return macro_;}
 	Sound& getSound() {return sound_;}
-	static bool ValidName(std::string);
+	static bool ValidName(std::string_view);
 };
 
 class DictionaryMutex {
@@ -84,81 +90,167 @@ public:
 			item_{item} {
 		item_.semaphor_++;
 	}
+	// Running a macro lends its child lists; once the outermost run ends no
+	// reference into them survives, so copies may share them again.
 	~DictionaryMutex() noexcept {
-		item_.semaphor_--;
+		if ((--item_.semaphor_ == 0) && item_.isMacro())
+			item_.macro_.children_.Recall();
 	}
 };
 
+class DictionaryHandle {
+	friend class Dictionary;
+private:
+	size_t slot_ {std::numeric_limits<size_t>::max()};
+	uint32_t generation_ {0};
+};
+
 class Dictionary {
 private:
-	using DictionaryMap = std::map<std::string, DictionaryItem>;
-	using DictionaryIterator = DictionaryMap::iterator;
-	DictionaryMap dictionary_;
+	struct SymbolHash {
+		size_t operator()(Symbol name) const noexcept {
+			return std::hash<const std::string*>{}(name.id());
+		}
+	};
+	struct Slot {
+		DictionaryItem item_;
+		Symbol name_;
+		size_t position_ {0};
+		uint32_t generation_ {0};
+		uint64_t last_use_ {0};
+		bool used_ {false};
+	};
+	std::deque<Slot> slots_;
+	std::vector<size_t> free_slots_;
+	std::unordered_map<Symbol, size_t, SymbolHash> index_;
 	DictionaryItem invalid_item_;
-	DictionaryIterator begin() {return dictionary_.begin();}
-	DictionaryIterator end() {return dictionary_.end();}
+	Slot* FindSlot(std::string_view name) {
+		if (const auto symbol {Symbol::Find(name)})
+			if (const auto found {index_.find(*symbol)}; found != index_.end())
+				return &slots_[found->second];
+		return nullptr;
+	}
+	std::set<size_t> sound_slots_;
+	uint64_t clock_ {0};
+	DictionaryItem& Resident(Slot& slot) {
+		slot.last_use_ = ++clock_;
+		if (slot.item_.isSound()) slot.item_.sound_.PageIn();
+		return slot.item_;
+	}
+	void Erase(Slot& slot) {
+		index_.erase(slot.name_);
+		sound_slots_.erase(slot.position_);
+		slot.item_ = DictionaryItem();
+		slot.generation_++;
+		slot.used_ = false;
+		free_slots_.push_back(slot.position_);
+	}
+	template <typename Operation>
+	void ForEachSlot(Operation op) {
+		for (auto& slot : slots_)
+			if (slot.used_) op(slot);
+	}
+	template <typename Operation>
+	void ForEachSlot(Operation op) const {
+		for (auto& slot : slots_)
+			if (slot.used_) op(slot);
+	}
 public:
-	bool contains(std::string name) const {
-		return dictionary_.contains(name);
+	bool contains(std::string_view name) const {
+		const auto symbol {Symbol::Find(name)};
+		return symbol && index_.contains(*symbol);
+	}
+	DictionaryItem& Find(std::string_view name) {
+		if (Slot* slot {FindSlot(name)})
+			return Resident(*slot);
+		return invalid_item_;
 	}
-	DictionaryItem& Find(std::string name) {
-		if (dictionary_.contains(name))
-			return dictionary_[name];
-		else
-			return invalid_item_;
+	DictionaryItem& Find(DictionaryHandle& handle, std::string_view name) {
+		if (handle.slot_ < slots_.size()) {
+			Slot& slot {slots_[handle.slot_]};
+			if (slot.used_ && (slot.generation_ == handle.generation_) && (slot.name_ == name))
+				return Resident(slot);
+		}
+		if (Slot* slot {FindSlot(name)}) {
+			handle.slot_ = slot->position_;
+			handle.generation_ = slot->generation_;
+			return Resident(*slot);
+		}
+		return invalid_item_;
 	}
-	Sound& FindSound(std::string name) {
+	Sound& FindSound(std::string_view name) {
 		return Find(name).sound_;
 	}
 	Sound& FindSound(Blob& Q) {
-		const std::string name {Q["@"].atom()};
-		return FindSound(name);
+		return FindSound(Q["@"].atom());
 	}
-	DictionaryItem& Insert(DictionaryItem item, std::string name) {
+	DictionaryItem& Insert(DictionaryItem&& item, std::string_view name) {
 		if (!item.ValidName(name))
-			throw EError(name + ": Illegal character in name.");
-		if (contains(name))
-			throw EError(name + ": Name already used.");
-		dictionary_.insert( { { name, item } });
-		return Find(name);
-	}
-	Sound& InsertSound(std::string name) {
-		DictionaryItem item;
-		item.type_ = dic_item_type::sound;
-		return Insert(item, name).sound_;
-	}
-	bool Delete(std::string name, bool protect = false) {
-		if (auto item {dictionary_.find(name)}; item != dictionary_.end()) {
-			if (item->second.semaphor_)
+			throw EError(std::string{name} + ": Illegal character in name.");
+		const Symbol symbol {name};
+		if (index_.contains(symbol))
+			throw EError(std::string{name} + ": Name already used.");
+		size_t position {slots_.size()};
+		if (free_slots_.empty())
+			slots_.push_back(Slot {std::move(item), symbol, position});
+		else {
+			position = free_slots_.back();
+			free_slots_.pop_back();
+			slots_[position].item_ = std::move(item);
+			slots_[position].name_ = symbol;
+		}
+		Slot& slot {slots_[position]};
+		slot.used_ = true;
+		slot.last_use_ = ++clock_;
+		if (slot.item_.isSound()) sound_slots_.insert(position);
+		index_.emplace(symbol, position);
+		return slot.item_;
+	}
+	Sound& InsertSound(std::string_view name) {
+		return Insert(DictionaryItem(dic_item_type::sound), name).sound_;
+	}
+	bool Delete(std::string_view name, bool protect = false) {
+		if (Slot* slot {FindSlot(name)}) {
+			if (slot->item_.semaphor_)
 				return false;
-			if (protect && (item->second.protection_level_ > dic_item_protection::normal))
+			if (protect && (slot->item_.protection_level_ > dic_item_protection::normal))
 				return false;
-			else {
-				dictionary_.erase(item);
-				return true;
-			}
+			Erase(*slot);
+			return true;
 		} else
 			return false;
 	}
 	void Clear(bool protect = false) {
-		for (auto& item : dictionary_) {
-			if (item.second.semaphor_ == 0)
-				if ((!protect) || (item.second.protection_level_ <= dic_item_protection::normal))
-					item.second.markDeleted();
-		}
-		std::erase_if(dictionary_, [](const auto& item) {return item.second.isDeleted();});
+		ForEachSlot([this, protect](Slot& slot) {
+			if (slot.item_.semaphor_ == 0)
+				if ((!protect) || (slot.item_.protection_level_ <= dic_item_protection::normal))
+					Erase(slot);
+		});
 	}
-	void Rename(std::string old_name, std::string new_name) {
-		auto node {dictionary_.extract(old_name)};
-		node.key() = new_name;
-		dictionary_.insert(move(node));
+	void Rename(std::string_view old_name, std::string_view new_name) {
+		Slot* slot {FindSlot(old_name)};
+		if (!slot) return;
+		index_.erase(slot->name_);
+		slot->name_ = Symbol {new_name};
+		slot->generation_++;
+		index_.emplace(slot->name_, slot->position_);
 	}
 	void ListEntries(Blob& Q);
+	void ListMemory(bool);
+	size_t ResidentBytes() const;
+	size_t SlackBytes() const;
+	size_t MacroBytes() const;
+	size_t PagedOut() const;
+	void Spill(size_t);
+	std::vector<ImagePage> WriteImageSamples(ImageWriter&) const;
+	void WriteImageIndex(ImageWriter&, const std::vector<ImagePage>&) const;
+	void ReadImage(ImageReader&);
+	void Merge(Dictionary&&);
 	static void WriteSlotProtection(std::string&, dic_item_protection);
 	static void SWrite(std::string&, auto, std::streampos);
 	template <typename Operation>
 	void Apply(Operation op) {
-		for (auto& item : dictionary_) op(item.second);
+		ForEachSlot([&op](Slot& slot) {op(slot.item_);});
 	}
 };
 
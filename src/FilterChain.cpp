@@ -0,0 +1,192 @@
+//============================================================================
+// Name        : BoxyLady
+// Author      : Darren Green
+// Copyright   : (C) Darren Green 2011-2025
+// Description : Music sequencer
+//
+// License GPLv3+: GNU GPL version 3 or later <http://gnu.org/licenses/gpl.html>
+// This is free software; you are free to change and redistribute it.
+// There is NO WARRANTY, to the extent permitted by law.
+// Contact: darren.green@stir.ac.uk http://pinkmongoose.co.uk
+//============================================================================
+
+
+#include <algorithm>
+#include <cmath>
+
+#include "FilterChain.h"
+
+namespace BoxyLady {
+
+bool FilterChain::isStreamable(const Filter& filter) noexcept {
+	switch (filter.type()) {
+	case filter_type::amp:
+	case filter_type::distort:
+	case filter_type::ks_blend:
+	case filter_type::narrow_stereo:
+	case filter_type::inverse_lr:
+		return true;
+	default:
+		return filter.isBiquad();
+	}
+}
+
+FilterChain::FilterChain(const FilterVector& filters, music_size sample_rate) {
+	auto Mix = [](MatrixMixer mixer) {
+		return std::array<float_type, 4> {mixer(left, left), mixer(right, left), mixer(right, right), mixer(left, right)};
+	};
+	for (const Filter& filter : filters) {
+		if (!isStreamable(filter)) {
+			Segment segment;
+			segment.barrier = filter;
+			segments_.push_back(std::move(segment));
+			continue;
+		}
+		const bool wrap {filter.GetFlag(filter_direction::wrap)};
+		if (segments_.empty() || segments_.back().barrier
+				|| (filter.isBiquad() && segments_.back().has_cascade && (segments_.back().circular != wrap)))
+			segments_.emplace_back();
+		Segment& segment {segments_.back()};
+		Stage stage {stage_type::mix, BiquadCascade {}, Mix(MatrixMixer()), filter.gain()};
+		if (filter.isBiquad()) {
+			segment.circular = wrap;
+			segment.has_cascade = true;
+			if (!segment.stages.empty() && (segment.stages.back().type == stage_type::cascade)) {
+				segment.stages.back().cascade.Add(filter.Cascade(sample_rate));
+				continue;
+			}
+			stage.type = stage_type::cascade;
+			stage.cascade = filter.Cascade(sample_rate);
+		} else if (filter.type() == filter_type::amp)
+			stage.mix = Mix(MatrixMixer(filter.gain()));
+		else if (filter.type() == filter_type::narrow_stereo)
+			stage.mix = Mix(MatrixMixer(Stereo(1.0 - 0.5 * filter.gain()), Stereo(0.5 * filter.gain())));
+		else if (filter.type() == filter_type::inverse_lr)
+			stage.mix = Mix(MatrixMixer(0.0, 1.0));
+		else if (filter.type() == filter_type::distort)
+			stage.type = stage_type::distort;
+		else if (filter.type() == filter_type::ks_blend)
+			stage.type = stage_type::flip;
+		segment.stages.push_back(std::move(stage));
+	}
+}
+
+FilterChain::Memory FilterChain::Prepare(const Segment& segment) {
+	Memory memory;
+	for (const Stage& stage : segment.stages) {
+		memory.signs.push_back(((stage.type == stage_type::flip) && (Rand.uniform() > stage.gain)) ? -1.0 : 1.0);
+		memory.states.emplace_back(stage.cascade.size());
+	}
+	return memory;
+}
+
+template <size_t Lanes>
+void FilterChain::Stages(const Segment& segment, Memory& memory, float_type* buffer, size_t frames) {
+	const size_t samples {frames * Lanes};
+	for (size_t stage_index {0}; stage_index < segment.stages.size(); stage_index++) {
+		const Stage& stage {segment.stages[stage_index]};
+		switch (stage.type) {
+		case stage_type::cascade:
+			stage.cascade.Apply<Lanes>(buffer, frames, memory.states[stage_index].data());
+			break;
+		case stage_type::mix:
+			if constexpr (Lanes == 1) {
+				const float_type scale {0.5_flt * (stage.mix[0] + stage.mix[1] + stage.mix[2] + stage.mix[3])};
+				for (size_t index {0}; index < samples; index++)
+					buffer[index] *= scale;
+			} else
+				for (size_t index {0}; index < samples; index += 2) {
+					const float_type sample_left {buffer[index]}, sample_right {buffer[index + 1]};
+					buffer[index] = sample_left * stage.mix[0] + sample_right * stage.mix[1];
+					buffer[index + 1] = sample_right * stage.mix[2] + sample_left * stage.mix[3];
+				}
+			break;
+		case stage_type::distort:
+			for (size_t index {0}; index < samples; index++) {
+				const float_type value {buffer[index]};
+				buffer[index] = (value > 0.0_flt) ? pow(value, stage.gain) : -pow(-value, stage.gain);
+			}
+			break;
+		case stage_type::flip:
+			if (memory.signs[stage_index] < 0.0_flt)
+				for (size_t index {0}; index < samples; index++)
+					buffer[index] = -buffer[index];
+			break;
+		}
+	}
+}
+
+template <size_t Lanes>
+void FilterChain::Run(const Segment& segment, Memory& memory, music_type* data, size_t frames, bool write) {
+	std::array<float_type, Block * Lanes> buffer;
+	for (size_t start {0}; start < frames; start += Block) {
+		const size_t count {std::min(Block, frames - start)}, samples {count * Lanes};
+		music_type* block {data + start * Lanes};
+		for (size_t index {0}; index < samples; index++)
+			buffer[index] = static_cast<float_type>(block[index]) / PCMMax_f;
+		Stages<Lanes>(segment, memory, buffer.data(), count);
+		if (write)
+			for (size_t index {0}; index < samples; index++)
+				block[index] = static_cast<music_type>(std::clamp(buffer[index] * PCMMax_f, static_cast<float_type>(PCMMin), PCMMax_f));
+	}
+}
+
+void FilterChain::Process(const Segment& segment, MusicVector& music_data, int channels, size_t frames) {
+	if ((channels != 1) && (channels != 2))
+		throw EError("Filter chains only work on 1-2 channels.");
+	Memory memory {Prepare(segment)};
+	size_t settle {0};
+	for (const Stage& stage : segment.stages)
+		settle = std::min(frames, settle + std::min(frames, stage.cascade.Settle()));
+	auto Pass = [&segment, &memory, channels](music_type* data, size_t count, bool write) {
+		if (channels == 1)
+			Run<1>(segment, memory, data, count, write);
+		else
+			Run<2>(segment, memory, data, count, write);
+	};
+	if (segment.circular)
+		Pass(music_data.data() + (frames - settle) * channels, settle, false);
+	Pass(music_data.data(), frames, true);
+}
+
+void FilterChain::Apply(Sound& sound) const {
+	for (const Segment& segment : segments_)
+		if (segment.barrier)
+			sound.ApplyFilter(*segment.barrier);
+		else {
+			sound.AssertMusic();
+			Process(segment, sound.music_data_, sound.channels_, sound.p_samples_);
+		}
+}
+
+bool FilterChain::isStreaming() const noexcept {
+	return std::none_of(segments_.begin(), segments_.end(), [](const Segment& segment) {
+		return segment.barrier.has_value();
+	});
+}
+
+float_type FilterChain::PhaseDelay(float_type w) const noexcept {
+	float_type delay {0.0};
+	for (const Segment& segment : segments_)
+		for (const Stage& stage : segment.stages)
+			delay += stage.cascade.PhaseDelay(w);
+	return delay;
+}
+
+std::vector<FilterChain::Memory> FilterChain::Start() const {
+	std::vector<Memory> memory;
+	for (const Segment& segment : segments_)
+		memory.push_back(Prepare(segment));
+	return memory;
+}
+
+template <size_t Lanes>
+void FilterChain::Stream(float_type* buffer, size_t frames, std::vector<Memory>& memory) const {
+	for (size_t segment_index {0}; segment_index < segments_.size(); segment_index++)
+		Stages<Lanes>(segments_[segment_index], memory[segment_index], buffer, frames);
+}
+
+template void FilterChain::Stream<1>(float_type*, size_t, std::vector<Memory>&) const;
+template void FilterChain::Stream<2>(float_type*, size_t, std::vector<Memory>&) const;
+
+} //end namespace BoxyLady
@@ -0,0 +1,76 @@
+//============================================================================
+// Name        : BoxyLady
+// Author      : Darren Green
+// Copyright   : (C) Darren Green 2011-2025
+// Description : Music sequencer
+//
+// License GPLv3+: GNU GPL version 3 or later <http://gnu.org/licenses/gpl.html>
+// This is free software; you are free to change and redistribute it.
+// There is NO WARRANTY, to the extent permitted by law.
+// Contact: darren.green@stir.ac.uk http://pinkmongoose.co.uk
+//============================================================================
+
+
+#ifndef FILTERCHAIN_H_
+#define FILTERCHAIN_H_
+
+#include <optional>
+#include <vector>
+
+#include "Global.h"
+#include "Biquad.h"
+#include "Sound.h"
+
+namespace BoxyLady {
+
+// A FilterVector prepared for a Sound. Runs of filters that work frame by frame
+// (biquads, gains, stereo mixes, distortion) are fused and streamed in blocks of
+// float frames, so a chain costs about one pass over the data and is only
+// quantised once. Whole-buffer filters (fourier_*, pitch_scale, ks:reverse)
+// split the chain and are applied on their own.
+
+class FilterChain {
+private:
+	static constexpr size_t Block {256};
+	enum class stage_type {cascade, mix, distort, flip};
+	struct Stage {
+		stage_type type;
+		BiquadCascade cascade;
+		std::array<float_type, 4> mix;
+		float_type gain;
+	};
+	struct Segment {
+		std::vector<Stage> stages;
+		std::optional<Filter> barrier;
+		bool circular {false}, has_cascade {false};
+	};
+	std::vector<Segment> segments_;
+	static bool isStreamable(const Filter&) noexcept;
+public:
+	// Running state of one fused segment: filter memory and the ks:blend signs.
+	struct Memory {
+		std::vector<float_type> signs;
+		std::vector<std::vector<BiquadCascade::State>> states;
+	};
+private:
+	static Memory Prepare(const Segment&);
+	template <size_t Lanes>
+	static void Stages(const Segment&, Memory&, float_type*, size_t);
+	template <size_t Lanes>
+	static void Run(const Segment&, Memory&, music_type*, size_t, bool);
+	static void Process(const Segment&, MusicVector&, int, size_t);
+public:
+	explicit FilterChain(const FilterVector&, music_size);
+	void Apply(Sound&) const;
+	// Streaming use, e.g. inside a feedback loop; needs a chain with no barriers.
+	bool isStreaming() const noexcept;
+	// Phase delay of the biquad stages at w radians per sample, for tuning loops.
+	float_type PhaseDelay(float_type) const noexcept;
+	std::vector<Memory> Start() const;
+	template <size_t Lanes>
+	void Stream(float_type*, size_t, std::vector<Memory>&) const;
+};
+
+} //end namespace BoxyLady
+
+#endif /* FILTERCHAIN_H_ */
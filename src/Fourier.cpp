@@ -10,12 +10,16 @@
 // Contact: darren.green@stir.ac.uk http://pinkmongoose.co.uk
 //============================================================================
 
+#include <algorithm>
 #include <utility>
 #include <cmath>
 #include <bit>
+#include <map>
+#include <mutex>
 
 #include "Fourier.h"
 #include "Envelope.h"
+#include "Parallel.h"
 
 namespace BoxyLady {
 
@@ -28,11 +32,154 @@ inline float_type Gaussian(float_type value, float_type mu, float_type sigma) no
 	return exp(-0.5_flt*normalised*normalised);
 }
 
-void Fourier::Transform(MusicVector& music_data) {
+template <typename T>
+struct CacheEntry {
+	std::shared_ptr<const T> value;
+	size_t bytes {0}, last_use {0};
+};
+
+// Keeps `value` in an LRU cache of at most `budget` bytes, dropping the least
+// recently used entries to make room. Anything bigger than the whole budget
+// is not kept at all. Entries still in use elsewhere live until released.
+template <typename Map, typename T>
+void Remember(Map& cache, const typename Map::key_type& key, const std::shared_ptr<const T>& value,
+		size_t bytes, size_t last_use, size_t budget) {
+	if (bytes > budget)
+		return;
+	size_t total {bytes};
+	for (const auto& [entry_key, entry] : cache)
+		total += entry.bytes;
+	while ((total > budget) && !cache.empty()) {
+		const auto oldest {std::ranges::min_element(cache, {}, [](const auto& item) {return item.second.last_use;})};
+		total -= oldest->second.bytes;
+		cache.erase(oldest);
+	}
+	cache.insert_or_assign(key, CacheEntry<T> {value, bytes, last_use});
+}
+
+std::shared_ptr<const Fourier::Plan> Fourier::GetPlan(size_t size) {
+	// Each thread remembers its last plan weakly, so an evicted plan is not kept alive.
+	thread_local std::weak_ptr<const Plan> last_plan;
+	thread_local size_t last_size {0};
+	if (last_size == size)
+		if (auto plan {last_plan.lock()})
+			return plan;
+	// Recursive, because a Bluestein plan transforms its chirp with the plan for a power of two.
+	static std::recursive_mutex mutex;
+	static std::map<size_t, CacheEntry<Plan>> plans;
+	static size_t clock {0};
+	const std::lock_guard lock {mutex};
+	if (const auto found {plans.find(size)}; found != plans.end()) {
+		found->second.last_use = ++clock;
+		last_size = size;
+		last_plan = found->second.value;
+		return found->second.value;
+	}
+	auto new_plan {std::make_unique<Plan>()};
+	constexpr double two_pi {6.283185307179586};
+	size_t rest {size};
+	for (const size_t radix : {4, 2, 3, 5, 7})
+		while ((rest > 1) && (rest % radix == 0)) {
+			new_plan->factors.push_back(radix);
+			rest /= radix;
+		}
+	if (rest == 1) {
+		if (size >= FourStepMinimum) {
+			new_plan->rows = 1;
+			for (const size_t radix : new_plan->factors)
+				if (new_plan->rows * new_plan->rows < size)
+					new_plan->rows *= radix;
+		}
+		new_plan->forward.reserve(size);
+		for (size_t index {0}; index < size; index++) {
+			const double theta {two_pi * static_cast<double>(index) / static_cast<double>(size)};
+			new_plan->forward.emplace_back(cos(theta), sin(theta));
+		}
+	} else if (size > 1) {
+		new_plan->factors.clear();
+		const size_t padded {std::bit_ceil(size * 2 - 1)};
+		ComplexVector filter_forward(padded, Complex {0.0}), filter_inverse(padded, Complex {0.0});
+		for (size_t index {0}; index < size; index++) {
+			const double theta {two_pi / 2.0 * static_cast<double>(index * index % (size * 2)) / static_cast<double>(size)};
+			const Complex chirp(cos(theta), sin(theta));
+			new_plan->chirp.push_back(chirp);
+			filter_forward[index] = std::conj(chirp);
+			filter_inverse[index] = chirp;
+			if (index) {
+				filter_forward[padded - index] = std::conj(chirp);
+				filter_inverse[padded - index] = chirp;
+			}
+		}
+		FFT(filter_forward, false);
+		FFT(filter_inverse, false);
+		new_plan->chirp_forward = std::move(filter_forward);
+		new_plan->chirp_inverse = std::move(filter_inverse);
+	}
+	std::shared_ptr<const Plan> plan {std::move(new_plan)};
+	// A plan over MaxPlanBytes, such as Bluestein on a long prime length, lives
+	// only as long as the transforms using it.
+	Remember(plans, size, plan, plan->bytes(), ++clock, MaxPlanBytes);
+	last_size = size;
+	last_plan = plan;
+	return plan;
+}
+
+// Smallest size of at least `size` with no prime factor above 7.
+size_t Fourier::FastSize(size_t size) noexcept {
+	size_t best {std::bit_ceil(size)};
+	for (size_t power_7 {1}; power_7 < best; power_7 *= 7)
+		for (size_t power_5 {power_7}; power_5 < best; power_5 *= 5)
+			for (size_t power_3 {power_5}; power_3 < best; power_3 *= 3) {
+				size_t candidate {power_3};
+				while (candidate < size)
+					candidate *= 2;
+				best = std::min(best, candidate);
+			}
+	return best;
+}
+
+std::shared_ptr<const Fourier::Curve> Fourier::Window(size_t window_size) {
+	static std::mutex mutex;
+	static std::map<size_t, CacheEntry<Curve>> windows;
+	static size_t clock {0};
+	const std::lock_guard lock {mutex};
+	if (const auto found {windows.find(window_size)}; found != windows.end()) {
+		found->second.last_use = ++clock;
+		return found->second.value;
+	}
+	constexpr float_type halfpi {1.570796327};
+	auto new_window {std::make_shared<Curve>(window_size * 2)};
+	for (size_t index {0}; index < window_size * 2; index++) {
+		const float_type x {sin(static_cast<float_type>(index) / static_cast<float_type>(window_size) * halfpi)};
+		(*new_window)[index] = x * x;
+	}
+	std::shared_ptr<const Curve> window {std::move(new_window)};
+	Remember(windows, window_size, window, window->capacity() * sizeof(float_type), ++clock, MaxCurveBytes);
+	return window;
+}
+
+std::shared_ptr<const Fourier::Curve> Fourier::CachedCurve(const CurveKey& key, float_type (*Gain)(const CurveKey&, size_t)) {
+	static std::mutex mutex;
+	static std::map<CurveKey, CacheEntry<Curve>> curves;
+	static size_t clock {0};
+	const std::lock_guard lock {mutex};
+	if (const auto found {curves.find(key)}; found != curves.end()) {
+		found->second.last_use = ++clock;
+		return found->second.value;
+	}
+	const size_t bins {(std::get<1>(key) + 1) / 2};
+	auto new_curve {std::make_shared<Curve>(bins)};
+	for (size_t index {0}; index < bins; index++)
+		(*new_curve)[index] = Gain(key, index);
+	std::shared_ptr<const Curve> curve {std::move(new_curve)};
+	Remember(curves, key, curve, curve->capacity() * sizeof(float_type), ++clock, MaxCurveBytes);
+	return curve;
+}
+
+void Fourier::Transform(MusicVector& music_data, bool exact) {
 	size_ = music_data.size();
-	log_size_ = std::bit_width(size_);
-	rounded_size_ = std::bit_ceil(size_);
-	buffer_ = ComplexVector(rounded_size_,Complex(0.0_flt));
+	rounded_size_ = exact ? size_ : FastSize(size_);
+	buffer_.assign(rounded_size_, Complex(0.0_flt));
 	for (size_t index {0}; index < size_; index++)
 		buffer_[index] = music_data[index];
 	FFT(false);
@@ -45,91 +192,283 @@ void Fourier::InverseTransform(MusicVector& music_data) {
 		music_data[index] = static_cast<music_type>(std::real(buffer_[index]));
 }
 
-void Fourier::FFT(bool inverse) {
-	const size_t size {rounded_size_}, log_size {log_size_};
-	auto reverse_bits = [log_size](size_t value) {
-		size_t result = 0;
-		for (size_t bit {0}; bit < log_size; bit++) {
-			if (value & (1 << bit))
-				result |= 1 << (log_size - 1 - bit);
-		}
-		return result;
+void Fourier::TransformPair(const MusicVector& music_data, size_t frames, Fourier& left, Fourier& right, bool exact) {
+	left.size_ = right.size_ = frames;
+	left.rounded_size_ = right.rounded_size_ = exact ? frames : FastSize(frames);
+	const size_t size {left.rounded_size_};
+	left.buffer_.assign(size, Complex(0.0_flt));
+	right.buffer_.resize(size);
+	for (size_t index {0}; index < frames; index++)
+		left.buffer_[index] = Complex(music_data[index * 2], music_data[index * 2 + 1]);
+	left.FFT(false);
+	const Complex minus_half_i {0.0_flt, -0.5_flt};
+	for (size_t index {0}; index <= size / 2; index++) {
+		const size_t mirror {(size - index) % size};
+		const Complex packed {left.buffer_[index]}, packed_mirror {left.buffer_[mirror]};
+		left.buffer_[index] = 0.5_flt * (packed + std::conj(packed_mirror));
+		left.buffer_[mirror] = 0.5_flt * (packed_mirror + std::conj(packed));
+		right.buffer_[index] = minus_half_i * (packed - std::conj(packed_mirror));
+		right.buffer_[mirror] = minus_half_i * (packed_mirror - std::conj(packed));
+	}
+}
+
+// Only the Hermitian part of each spectrum survives into a real signal, so
+// both halves are symmetrised before they are packed back together.
+void Fourier::InverseTransformPair(Fourier& left, Fourier& right, MusicVector& music_data) {
+	const size_t size {left.rounded_size_};
+	if (right.rounded_size_ != size)
+		throw EError("Fourier: stereo halves must be the same size.");
+	const Complex i {0.0_flt, 1.0_flt};
+	for (size_t index {0}; index <= size / 2; index++) {
+		const size_t mirror {(size - index) % size};
+		const Complex left_part {0.5_flt * (left.buffer_[index] + std::conj(left.buffer_[mirror]))},
+			right_part {0.5_flt * (right.buffer_[index] + std::conj(right.buffer_[mirror]))};
+		left.buffer_[index] = left_part + i * right_part;
+		left.buffer_[mirror] = std::conj(left_part) + i * std::conj(right_part);
+	}
+	left.FFT(true);
+	for (size_t index {0}; index < left.size_; index++) {
+		music_data[index * 2] = static_cast<music_type>(std::real(left.buffer_[index]));
+		music_data[index * 2 + 1] = static_cast<music_type>(std::imag(left.buffer_[index]));
+	}
+}
+
+// One radix pass of a self-sorting (Stockham) decimation in frequency.
+template <size_t Radix>
+void RadixPass(const Fourier::Complex* source, Fourier::Complex* dest, size_t size, size_t stride,
+		const Fourier::ComplexVector& twiddles, bool inverse) {
+	using Complex = Fourier::Complex;
+	const size_t span {size / stride / Radix};
+	const float_type sign {inverse ? -1.0_flt : 1.0_flt};
+	auto Rotate = [sign](Complex value) {
+		return Complex(-sign * value.imag(), sign * value.real());
 	};
-	for (size_t index {0}; index < size; index++) {
-		if (index < reverse_bits(index))
-			std::swap(buffer_[index], buffer_[reverse_bits(index)]);
-	}
-	for (size_t length {2}; length <= size; length <<= 1) {
-		float_type theta {physics::TwoPi / length * (inverse ? -1.0_flt : 1.0_flt)};
-		Complex exp_i_theta(cos(theta), sin(theta));
-		for (size_t block {0}; block < size; block += length) {
-			Complex complex_w {1.0_flt};
-			for (size_t block_index {0}; block_index < length / 2; block_index++) {
-				Complex complex_u {buffer_[block + block_index]},
-					complex_V {buffer_[block + block_index + length / 2] * complex_w};
-				buffer_[block + block_index] = complex_u + complex_V;
-				buffer_[block + block_index + length / 2] = complex_u - complex_V;
-				complex_w *= exp_i_theta;
+	// Odd radices pair term j with term Radix - j and multiply by real cosines and sines.
+	// `twiddles` is the forward table; the inverse uses its conjugates.
+	float_type cosines[Radix], sines[Radix];
+	for (size_t index {0}; index < Radix; index++) {
+		cosines[index] = twiddles[index * (size / Radix)].real();
+		sines[index] = twiddles[index * (size / Radix)].imag();
+	}
+	for (size_t block {0}; block < span; block++) {
+		Complex twiddle[Radix];
+		for (size_t output {0}; output < Radix; output++) {
+			const Complex value {twiddles[block * output * stride]};
+			twiddle[output] = inverse ? std::conj(value) : value;
+		}
+		for (size_t lane {0}; lane < stride; lane++) {
+			Complex input[Radix];
+			for (size_t term {0}; term < Radix; term++)
+				input[term] = source[lane + stride * (block + span * term)];
+			Complex* out {dest + lane + stride * Radix * block};
+			if constexpr (Radix == 2) {
+				out[0] = input[0] + input[1];
+				out[stride] = (input[0] - input[1]) * twiddle[1];
+			} else if constexpr (Radix == 4) {
+				const Complex sum_02 {input[0] + input[2]}, difference_02 {input[0] - input[2]},
+					sum_13 {input[1] + input[3]}, difference_13 {Rotate(input[1] - input[3])};
+				out[0] = sum_02 + sum_13;
+				out[stride] = (difference_02 + difference_13) * twiddle[1];
+				out[stride * 2] = (sum_02 - sum_13) * twiddle[2];
+				out[stride * 3] = (difference_02 - difference_13) * twiddle[3];
+			} else {
+				constexpr size_t half {Radix / 2};
+				Complex sums[half + 1], differences[half + 1];
+				out[0] = input[0];
+				for (size_t term {1}; term <= half; term++) {
+					sums[term] = input[term] + input[Radix - term];
+					differences[term] = input[term] - input[Radix - term];
+					out[0] += sums[term];
+				}
+				for (size_t output {1}; output <= half; output++) {
+					Complex real_part {input[0]}, imaginary_part {0.0};
+					for (size_t term {1}; term <= half; term++) {
+						real_part += sums[term] * cosines[term * output % Radix];
+						imaginary_part += differences[term] * sines[term * output % Radix];
+					}
+					out[stride * output] = (real_part + Rotate(imaginary_part)) * twiddle[output];
+					out[stride * (Radix - output)] = (real_part - Rotate(imaginary_part)) * twiddle[Radix - output];
+				}
 			}
 		}
 	}
+}
+
+void Fourier::MixedRadix(Complex* data, Complex* work, const Plan& plan, bool inverse) {
+	const size_t size {plan.forward.size()};
+	const ComplexVector& twiddles {plan.forward};
+	Complex* source {data}, *dest {work};
+	size_t stride {1};
+	for (const size_t radix : plan.factors) {
+		switch (radix) {
+		case 2: RadixPass<2>(source, dest, size, stride, twiddles, inverse); break;
+		case 3: RadixPass<3>(source, dest, size, stride, twiddles, inverse); break;
+		case 4: RadixPass<4>(source, dest, size, stride, twiddles, inverse); break;
+		case 5: RadixPass<5>(source, dest, size, stride, twiddles, inverse); break;
+		default: RadixPass<7>(source, dest, size, stride, twiddles, inverse);
+		}
+		std::swap(source, dest);
+		stride *= radix;
+	}
+	if (source != data)
+		std::copy(source, source + size, data);
+}
+
+// dest (columns by rows) = source (rows by columns) transposed and scaled, in
+// tiles small enough that both sides stay in cache.
+void Fourier::Transpose(const Complex* source, Complex* dest, size_t rows, size_t columns, size_t threads, float_type scale) {
+	constexpr size_t tile {32};
+	ParallelFor((rows + tile - 1) / tile, threads, [=](size_t block) {
+		const size_t row_stop {std::min(rows, (block + 1) * tile)};
+		for (size_t column_start {0}; column_start < columns; column_start += tile) {
+			const size_t column_stop {std::min(columns, column_start + tile)};
+			for (size_t row {block * tile}; row < row_stop; row++)
+				for (size_t column {column_start}; column < column_stop; column++)
+					dest[column * rows + row] = source[row * columns + column] * scale;
+		}
+	});
+}
+
+// Transforms `count` contiguous rows of `length`, each thread with its own work
+// array. If `twiddles` is given, element k of row r is then multiplied by
+// twiddles[r * k], conjugated for the inverse.
+void Fourier::TransformRows(Complex* data, size_t count, size_t length, bool inverse, size_t threads,
+		const ComplexVector* twiddles) {
+	// Planned here, since a Bluestein plan may be under construction with the plan lock held.
+	const auto plan_pointer {GetPlan(length)};
+	const Plan& plan {*plan_pointer};
+	threads = std::min(threads, count);
+	ParallelFor(threads, threads, [=, &plan](size_t thread) {
+		ComplexVector work(length);
+		for (size_t row {thread}; row < count; row += threads) {
+			Complex* start {data + row * length};
+			MixedRadix(start, work.data(), plan, inverse);
+			if (!twiddles)
+				continue;
+			// A double-precision recurrence, resynchronised from the table every
+			// 64 points, avoids striding through it.
+			const std::complex<double> step {std::polar(1.0, (inverse ? -6.283185307179586 : 6.283185307179586)
+				* static_cast<double>(row) / static_cast<double>(twiddles->size()))};
+			for (size_t block {0}; block < length; block += 64) {
+				const Complex entry {(*twiddles)[row * block]};
+				std::complex<double> twiddle {inverse ? std::conj(entry) : entry};
+				const size_t stop {std::min(length, block + 64)};
+				for (size_t index {block}; index < stop; index++, twiddle *= step)
+					start[index] *= Complex(twiddle);
+			}
+		}
+	});
+}
+
+// Bailey's four-step FFT. With size = rows * columns, point r + rows * c is
+// transformed along c, twiddled, transformed along r and lands at c + columns * r.
+// The sub-transforms fit in cache and are shared between threads.
+void Fourier::FourStep(ComplexVector& buffer, const Plan& plan, bool inverse) {
+	const size_t size {buffer.size()}, rows {plan.rows}, columns {size / rows}, threads {HardwareThreads()};
+	ComplexVector matrix(size);
+	Transpose(buffer.data(), matrix.data(), columns, rows, threads);
+	TransformRows(matrix.data(), rows, columns, inverse, threads, &plan.forward);
+	Transpose(matrix.data(), buffer.data(), rows, columns, threads);
+	TransformRows(buffer.data(), columns, rows, inverse, threads);
+	Transpose(buffer.data(), matrix.data(), columns, rows, threads,
+		inverse ? 1.0_flt / static_cast<float_type>(size) : 1.0_flt);
+	buffer.swap(matrix);
+}
+
+// Bluestein: the transform becomes a convolution with a chirp, done at a power of two.
+void Fourier::Bluestein(ComplexVector& buffer, const Plan& plan, bool inverse) {
+	const size_t size {buffer.size()}, padded {plan.chirp_forward.size()};
+	auto Chirp = [&plan, inverse](size_t index) {
+		return inverse ? std::conj(plan.chirp[index]) : plan.chirp[index];
+	};
+	ComplexVector work(padded, Complex {0.0});
+	for (size_t index {0}; index < size; index++)
+		work[index] = buffer[index] * Chirp(index);
+	FFT(work, false);
+	const ComplexVector& filter {inverse ? plan.chirp_inverse : plan.chirp_forward};
+	for (size_t index {0}; index < padded; index++)
+		work[index] *= filter[index];
+	FFT(work, true);
+	for (size_t index {0}; index < size; index++)
+		buffer[index] = work[index] * Chirp(index);
+}
+
+void Fourier::FFT(ComplexVector& buffer, bool inverse) {
+	const size_t size {buffer.size()};
+	const auto plan_pointer {GetPlan(size)};
+	const Plan& plan {*plan_pointer};
+	if (plan.rows && (HardwareThreads() >= FourStepThreads)) {
+		FourStep(buffer, plan, inverse);
+		return;
+	}
+	if (!plan.factors.empty()) {
+		ComplexVector work(size);
+		MixedRadix(buffer.data(), work.data(), plan, inverse);
+	} else if (!plan.chirp.empty())
+		Bluestein(buffer, plan, inverse);
 	if (inverse) {
-		for (Complex& index : buffer_) index /= size;
+		for (Complex& index : buffer) index /= size;
 	}
 }
 
+float_type Fourier::GainCurve(const CurveKey& key, size_t index) {
+	const auto [kind, rounded_size, sample_rate, low_gain, low_shoulder, high_shoulder, high_gain] = key;
+	const float_type frequency_multiplier {static_cast<float_type>(rounded_size)
+		/ static_cast<float_type>(sample_rate)},
+		index_frequency {static_cast<float_type>(index) / frequency_multiplier};
+	if (index_frequency < low_shoulder)
+		return low_gain;
+	else if (index_frequency > high_shoulder)
+		return high_gain;
+	const float_type shoulder_fraction {(log(index_frequency / low_shoulder))
+		/ log(high_shoulder / low_shoulder)};
+	return exp((1.0_flt - shoulder_fraction) * log(low_gain) + shoulder_fraction * log(high_gain));
+}
+
+float_type Fourier::BandpassCurve(const CurveKey& key, size_t index) {
+	using BoxyLady::physics::eHalf;
+	constexpr float_type log_2 {0.69314718_flt};
+	const auto [kind, rounded_size, sample_rate, frequency, bandwidth, filter_gain, comb] = key;
+	const float_type frequency_multiplier {static_cast<float_type>(rounded_size)
+		/ static_cast<float_type>(sample_rate)};
+	float_type index_frequency {static_cast<float_type>(index) / frequency_multiplier};
+	if (comb != 0.0_flt) while (index_frequency > eHalf*frequency) index_frequency -= frequency;
+	const float_type gaussian {Gaussian(log(index_frequency), log(frequency), bandwidth * log_2)};
+	return exp(gaussian * log(filter_gain));
+}
+
 void Fourier::GainFilter(float_type low_gain, float_type low_shoulder,
 		float_type high_shoulder, float_type high_gain, size_t sample_rate) {
-	const float_type frequency_multiplier {static_cast<float_type>(rounded_size_)
-		/ static_cast<float_type>(sample_rate)};
-	for (size_t index {0}; index < rounded_size_ / 2; index++) {
-		float_type gain;
-		const float_type index_frequency {static_cast<float_type>(index)
-			/ frequency_multiplier};
-		if (index_frequency < low_shoulder)
-			gain = low_gain;
-		else if (index_frequency > high_shoulder)
-			gain = high_gain;
-		else {
-			const float_type shoulder_fraction {(log(
-				index_frequency / low_shoulder))
-				/ log(high_shoulder / low_shoulder)};
-			gain = exp(
-				(1.0_flt - shoulder_fraction) * log(low_gain)
-				+ shoulder_fraction * log(high_gain));
-		}
-		buffer_[index] *= gain;
-		buffer_[rounded_size_ - index - 1] *= gain;
+	const auto curve {CachedCurve({0, rounded_size_, sample_rate, low_gain, low_shoulder, high_shoulder, high_gain},
+		GainCurve)};
+	for (size_t index {0}; index < (rounded_size_ + 1) / 2; index++) {
+		buffer_[index] *= (*curve)[index];
+		if (index != rounded_size_ - index - 1)
+			buffer_[rounded_size_ - index - 1] *= (*curve)[index];
 	}
 }
 
 void Fourier::BandpassFilter(float_type frequency, float_type bandwidth,
 		float_type filter_gain, bool comb, size_t sample_rate) {
-	using BoxyLady::physics::eHalf;
-	constexpr float_type log_2 {0.69314718_flt};
-	const float_type frequency_multiplier {static_cast<float_type>(rounded_size_)
-			/ static_cast<float_type>(sample_rate)},
-		log_gain {log(filter_gain)},
-		log_frequency {log(frequency)},
-		log_bandwidth {bandwidth * log_2};
-	for (size_t index {0}; index < rounded_size_ / 2; index++) {
-		float_type index_frequency {static_cast<float_type>(index) / frequency_multiplier};
-		if (comb) while (index_frequency > eHalf*frequency) index_frequency -= frequency;
-		const float_type gaussian {Gaussian(log(index_frequency), log_frequency, log_bandwidth)},
-			gain {exp(gaussian * log_gain)};
-		buffer_[index] *= gain;
-		buffer_[rounded_size_ - index - 1] *= gain;
+	const auto curve {CachedCurve({1, rounded_size_, sample_rate, frequency, bandwidth, filter_gain, comb ? 1.0_flt : 0.0_flt},
+		BandpassCurve)};
+	for (size_t index {0}; index < (rounded_size_ + 1) / 2; index++) {
+		buffer_[index] *= (*curve)[index];
+		if (index != rounded_size_ - index - 1)
+			buffer_[rounded_size_ - index - 1] *= (*curve)[index];
 	}
 }
 
 void Fourier::Shift(float_type shift_frequency, size_t sample_rate) {
-	ComplexVector temp {buffer_};
+	scratch_ = buffer_;
+	ComplexVector& temp {scratch_};
 	const float_type frequency_multiplier {static_cast<float_type>(rounded_size_)
 		/ static_cast<float_type>(sample_rate)};
 	const music_pos shift {static_cast<music_pos>(shift_frequency * frequency_multiplier)};
-	for (music_pos index {0}; std::cmp_less(index, rounded_size_ / 2); index++) {
+	const size_t half {(rounded_size_ + 1) / 2};
+	for (music_pos index {0}; std::cmp_less(index, half); index++) {
 		const music_pos shifted_index {index - shift};
-		if ((shifted_index >= 0) && (std::cmp_less(shifted_index, rounded_size_ / 2))) {
+		if ((shifted_index >= 0) && (std::cmp_less(shifted_index, half))) {
 			temp[index] = buffer_[shifted_index];
 			temp[rounded_size_ - index - 1] = buffer_[rounded_size_ - shifted_index - 1];
 		} else {
@@ -137,18 +476,20 @@ void Fourier::Shift(float_type shift_frequency, size_t sample_rate) {
 			temp[rounded_size_ - index - 1] = Complex(0.0_flt);
 		}
 	}
-	buffer_ = temp;
+	std::swap(buffer_, scratch_);
 }
 
 void Fourier::Scale(float_type factor) {
-	ComplexVector temp {buffer_};
-	for (music_pos index {0}; std::cmp_less(index, rounded_size_ / 2); index++) {
+	scratch_ = buffer_;
+	ComplexVector& temp {scratch_};
+	const size_t half {(rounded_size_ + 1) / 2};
+	for (music_pos index {0}; std::cmp_less(index, half); index++) {
 		const float_type shifted {static_cast<float_type>(index) / factor},
 			remainder {shifted - floor(shifted)};
 		const music_pos shifted_index {static_cast<music_pos>(shifted)};
-		if (std::cmp_less(shifted_index, rounded_size_ / 2)) {
+		if (std::cmp_less(shifted_index, half)) {
 			music_pos shifted_high {shifted_index + 1};
-			if (std::cmp_equal(shifted_high, rounded_size_ / 2))
+			if (std::cmp_equal(shifted_high, half))
 				shifted_high--;
 			temp[index] = (1.0_flt - remainder) * buffer_[shifted_index]
 					+ remainder * buffer_[shifted_high];
@@ -160,7 +501,7 @@ void Fourier::Scale(float_type factor) {
 			temp[rounded_size_ - index - 1] = Complex(0.0_flt);
 		}
 	}
-	buffer_ = temp;
+	std::swap(buffer_, scratch_);
 }
 
 float_type Fourier::RMS(int scaling) {
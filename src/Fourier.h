@@ -14,6 +14,8 @@
 #define FOURIER_H_
 
 #include <complex>
+#include <memory>
+#include <tuple>
 #include <vector>
 
 #include "Global.h"
@@ -22,19 +24,61 @@
 namespace BoxyLady {
 
 class Fourier {
-private:
+public:
 	using Complex = std::complex<float_type>;
 	using ComplexVector = std::vector<Complex>;
-	ComplexVector buffer_;
-	void FFT(bool);
-	size_t size_ {0}, log_size_ {0}, rounded_size_ {0};
+	using Curve = std::vector<float_type>;
+	// Everything a transform of one size needs. Sizes with no prime factor above
+	// 7 run as radix 4/2/3/5/7 passes; any other size is done by Bluestein's
+	// chirp-z convolution at a power of two. Smooth sizes from FourStepMinimum up
+	// also split into `rows` by size/rows, for a four-step FFT whose
+	// sub-transforms are shared between FourStepThreads or more threads. Inverse
+	// twiddles are the conjugates of `forward`. Plans are cached per process and
+	// the least recently used are dropped beyond MaxPlanBytes; window tables and
+	// gain curves likewise beyond MaxCurveBytes each.
+	struct Plan {
+		std::vector<size_t> factors;
+		size_t rows {0};
+		ComplexVector forward, chirp, chirp_forward, chirp_inverse;
+		size_t bytes() const noexcept {
+			return factors.capacity() * sizeof(size_t) + (forward.capacity() + chirp.capacity()
+				+ chirp_forward.capacity() + chirp_inverse.capacity()) * sizeof(Complex);
+		}
+	};
+	static std::shared_ptr<const Plan> GetPlan(size_t);
+	static void FFT(ComplexVector&, bool);
+	static size_t FastSize(size_t) noexcept;
+	static std::shared_ptr<const Curve> Window(size_t);
+private:
+	// Per-bin gains keyed by filter kind, bin count, sample rate and parameters.
+	using CurveKey = std::tuple<int, size_t, size_t, float_type, float_type, float_type, float_type>;
+	static std::shared_ptr<const Curve> CachedCurve(const CurveKey&, float_type (*)(const CurveKey&, size_t));
+	static float_type GainCurve(const CurveKey&, size_t);
+	static float_type BandpassCurve(const CurveKey&, size_t);
+	ComplexVector buffer_, scratch_;
+	static constexpr size_t FourStepMinimum {size_t {1} << 18}, FourStepThreads {4},
+		MaxPlanBytes {size_t {64} << 20}, MaxCurveBytes {size_t {16} << 20};
+	static void MixedRadix(Complex*, Complex*, const Plan&, bool);
+	static void Transpose(const Complex*, Complex*, size_t, size_t, size_t, float_type = 1.0);
+	static void TransformRows(Complex*, size_t, size_t, bool, size_t, const ComplexVector* = nullptr);
+	static void FourStep(ComplexVector&, const Plan&, bool);
+	static void Bluestein(ComplexVector&, const Plan&, bool);
+	void FFT(bool inverse) {
+		FFT(buffer_, inverse);
+	}
+	size_t size_ {0}, rounded_size_ {0};
 public:
 	explicit Fourier() = default;
-	explicit Fourier(MusicVector& music_data) {
-		Transform(music_data);
+	explicit Fourier(MusicVector& music_data, bool exact = false) {
+		Transform(music_data, exact);
 	}
-	void Transform(MusicVector&);
+	// Pads to FastSize unless `exact`, which keeps the transform circular over the data.
+	void Transform(MusicVector&, bool = false);
 	void InverseTransform(MusicVector&);
+	// Interleaved stereo in one complex transform: left as the real part,
+	// right as the imaginary part, separated by conjugate symmetry.
+	static void TransformPair(const MusicVector&, size_t, Fourier&, Fourier&, bool = false);
+	static void InverseTransformPair(Fourier&, Fourier&, MusicVector&);
 	void GainFilter(float_type, float_type, float_type, float_type, size_t);
 	void BandpassFilter(float_type, float_type, float_type, bool, size_t);
 	void Shift(float_type, size_t);
@@ -43,6 +43,7 @@ inline constexpr float_type pow(float_type base, float_type exp_val) noexcept {r
 inline constexpr float_type sqrt(float_type val) noexcept {return std::sqrtf(val);}
 inline constexpr float_type sin(float_type val) noexcept {return std::sinf(val);}
 inline constexpr float_type cos(float_type val) noexcept {return std::cosf(val);}
+inline constexpr float_type tan(float_type val) noexcept {return std::tanf(val);}
 inline constexpr float_type sinh(float_type val) noexcept {return std::sinhf(val);}
 inline constexpr float_type floor(float_type val) noexcept {return std::floorf(val);}
 #endif
@@ -60,6 +61,7 @@ inline constexpr float_type pow(float_type base, float_type exp_val) noexcept {r
 inline constexpr float_type sqrt(float_type val) noexcept {return std::sqrt(val);}
 inline constexpr float_type sin(float_type val) noexcept {return std::sin(val);}
 inline constexpr float_type cos(float_type val) noexcept {return std::cos(val);}
+inline constexpr float_type tan(float_type val) noexcept {return std::tan(val);}
 inline constexpr float_type sinh(float_type val) noexcept {return std::sinh(val);}
 inline constexpr float_type floor(float_type val) noexcept {return std::floor(val);}
 #endif
@@ -70,6 +72,7 @@ inline constexpr float_type float_type_max = std::numeric_limits<float_type>::ma
 inline constexpr int int_min = std::numeric_limits<int>::min(),
 	int_max = std::numeric_limits<int>::max();
 inline constexpr long long int longlong_max = std::numeric_limits<long long int>::max();
+inline constexpr float_type MegaByte {1024.0 * 1024.0};
 
 template <typename T>
 concept Numeric = std::is_arithmetic_v<T>;
@@ -0,0 +1,125 @@
+//============================================================================
+// Name        : BoxyLady
+// Author      : Darren Green
+// Copyright   : (C) Darren Green 2011-2025
+// Description : Music sequencer
+//
+// License GPLv3+: GNU GPL version 3 or later <http://gnu.org/licenses/gpl.html>
+// This is free software; you are free to change and redistribute it.
+// There is NO WARRANTY, to the extent permitted by law.
+// Contact: darren.green@stir.ac.uk http://pinkmongoose.co.uk
+//============================================================================
+
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include "Image.h"
+
+namespace BoxyLady {
+
+ImageWriter::ImageWriter(std::string file_name) :
+		file_{file_name, std::ios::out | std::ios::binary}, file_name_{file_name} {
+	if (!file_.is_open())
+		throw EError("Saving image [" + file_name + "]: Open failed.");
+}
+
+void ImageWriter::WriteString(std::string_view text) {
+	Write(static_cast<uint32_t>(text.size()));
+	file_.write(text.data(), text.size());
+}
+
+void ImageWriter::WriteBlob(const Blob& blob) {
+	Write(blob.delimiter_);
+	WriteString(blob.key_.str());
+	WriteString(blob.val_);
+	Write(static_cast<uint32_t>(blob.children_.size()));
+	for (const auto& child : blob.children_) WriteBlob(child);
+}
+
+ImagePage ImageWriter::WriteSamples(const MusicVector& music_data) {
+	ImagePage page {file_name_, Tell(), music_data.size()};
+	file_.write(static_cast<const char*>(static_cast<const void*>(music_data.data())),
+		music_data.size() * sizeof(music_type));
+	return page;
+}
+
+// Streams a paged-out Sound from its spill or image file, a chunk at a time,
+// so saving never pages the whole sample back into memory.
+ImagePage ImageWriter::CopySamples(const ImagePage& source) {
+	constexpr size_t Chunk {size_t {1} << 20};
+	std::ifstream file(source.file_name, std::ios::in | std::ios::binary);
+	if (!file.is_open())
+		throw EError("Image [" + source.file_name + "]: Cannot read sample data.");
+	file.seekg(source.offset);
+	ImagePage page {file_name_, Tell(), source.size};
+	std::vector<char> buffer(std::min(Chunk, source.size * sizeof(music_type)));
+	for (size_t remaining {source.size * sizeof(music_type)}; remaining > 0; ) {
+		const size_t count {std::min(remaining, buffer.size())};
+		if (!file.read(buffer.data(), static_cast<std::streamsize>(count)))
+			throw EError("Image [" + source.file_name + "]: Sample data truncated.");
+		file_.write(buffer.data(), static_cast<std::streamsize>(count));
+		remaining -= count;
+	}
+	return page;
+}
+
+void ImageWriter::WritePage(const ImagePage& page) {
+	Write(static_cast<int64_t>(page.offset));
+	Write(static_cast<uint64_t>(page.size));
+}
+
+void ImageWriter::Close() {
+	file_.close();
+	if (!file_)
+		throw EError("Saving image [" + file_name_ + "]: Write failed.");
+}
+
+bool ImagePage::isIn(const std::string& other) const {
+	std::error_code error;
+	return (file_name == other) || std::filesystem::equivalent(file_name, other, error);
+}
+
+ImageReader::ImageReader(std::string file_name) :
+		file_{file_name, std::ios::in | std::ios::binary}, file_name_{file_name} {
+	if (!file_.is_open())
+		throw EError("Opening image [" + file_name + "]: Opening failed. Is it there?");
+}
+
+std::string ImageReader::ReadString() {
+	std::string text(Read<uint32_t>(), '\0');
+	file_.read(text.data(), text.size());
+	Check();
+	return text;
+}
+
+void ImageReader::ReadBlob(Blob& blob) {
+	blob.delimiter_ = Read<char>();
+	blob.key_ = Symbol {ReadString()};
+	blob.val_ = ReadString();
+	const uint32_t count {Read<uint32_t>()};
+	blob.children_.clear();
+	blob.children_.resize(count);
+	for (uint32_t index {0}; index < count; index++)
+		ReadBlob(blob.children_[index]);
+	blob.children_.Recall();
+}
+
+ImagePage ImageReader::ReadPage() {
+	const int64_t offset {Read<int64_t>()};
+	const uint64_t size {Read<uint64_t>()};
+	return ImagePage {file_name_, static_cast<std::streamoff>(offset), static_cast<size_t>(size)};
+}
+
+void ImageReader::ReadSamples(const ImagePage& page, MusicVector& music_data) {
+	std::ifstream file(page.file_name, std::ios::in | std::ios::binary);
+	if (!file.is_open())
+		throw EError("Image [" + page.file_name + "]: Cannot page in sample data.");
+	music_data.resize(page.size);
+	file.seekg(page.offset);
+	file.read(static_cast<char*>(static_cast<void*>(music_data.data())), page.size * sizeof(music_type));
+	if (!file)
+		throw EError("Image [" + page.file_name + "]: Sample data truncated.");
+}
+
+} //end namespace BoxyLady
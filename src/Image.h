@@ -0,0 +1,93 @@
+//============================================================================
+// Name        : BoxyLady
+// Author      : Darren Green
+// Copyright   : (C) Darren Green 2011-2025
+// Description : Music sequencer
+//
+// License GPLv3+: GNU GPL version 3 or later <http://gnu.org/licenses/gpl.html>
+// This is free software; you are free to change and redistribute it.
+// There is NO WARRANTY, to the extent permitted by law.
+// Contact: darren.green@stir.ac.uk http://pinkmongoose.co.uk
+//============================================================================
+
+#ifndef IMAGE_H_
+#define IMAGE_H_
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <type_traits>
+
+#include "Global.h"
+#include "Blob.h"
+#include "Waveform.h"
+
+namespace BoxyLady {
+
+// Session images: a header, the sample data of every Sound, then an index of
+// dictionary entries, config and RNG state. Restoring reads only the index;
+// sample data is paged in the first time a Sound is looked up.
+
+inline constexpr std::string_view ImageMagic {"BOXYIMG1"};
+
+struct ImagePage {
+	std::string file_name {""};
+	std::streamoff offset {0};
+	size_t size {0};
+	std::shared_ptr<TempFilename> spill {};
+	bool isIn(const std::string&) const;
+};
+
+class ImageWriter {
+private:
+	std::ofstream file_;
+	std::string file_name_;
+public:
+	explicit ImageWriter(std::string);
+	template <typename T> requires std::is_trivially_copyable_v<T>
+	void Write(const T& data) {
+		file_.write(static_cast<const char*>(static_cast<const void*>(&data)), sizeof(T));
+	}
+	void WriteString(std::string_view);
+	void WriteBlob(const Blob&);
+	ImagePage WriteSamples(const MusicVector&);
+	ImagePage CopySamples(const ImagePage&);
+	void WritePage(const ImagePage&);
+	std::streamoff Tell() {
+		return file_.tellp();
+	}
+	void Seek(std::streamoff position) {
+		file_.seekp(position);
+	}
+	void Close();
+};
+
+class ImageReader {
+private:
+	std::ifstream file_;
+	std::string file_name_;
+	void Check() const {
+		if (!file_) throw EError("Image [" + file_name_ + "]: Unexpected end of file.");
+	}
+public:
+	explicit ImageReader(std::string);
+	template <typename T> requires std::is_trivially_copyable_v<T>
+	T Read() {
+		T data;
+		file_.read(static_cast<char*>(static_cast<void*>(&data)), sizeof(T));
+		Check();
+		return data;
+	}
+	std::string ReadString();
+	void ReadBlob(Blob&);
+	ImagePage ReadPage();
+	void Seek(std::streamoff position) {
+		file_.seekg(position);
+		Check();
+	}
+	static void ReadSamples(const ImagePage&, MusicVector&);
+};
+
+} //end namespace BoxyLady
+
+#endif /* IMAGE_H_ */
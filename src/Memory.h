@@ -0,0 +1,99 @@
+//============================================================================
+// Name        : BoxyLady
+// Author      : Darren Green
+// Copyright   : (C) Darren Green 2011-2025
+// Description : Music sequencer
+//
+// License GPLv3+: GNU GPL version 3 or later <http://gnu.org/licenses/gpl.html>
+// This is free software; you are free to change and redistribute it.
+// There is NO WARRANTY, to the extent permitted by law.
+// Contact: darren.green@stir.ac.uk http://pinkmongoose.co.uk
+//============================================================================
+
+#ifndef MEMORY_H_
+#define MEMORY_H_
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace BoxyLady {
+
+class MemoryStats {
+public:
+	static inline constexpr size_t LargeAllocation {64 * 1024};
+	struct Counter {
+		std::atomic<size_t> calls {0}, count {0}, bytes {0}, peak {0};
+	};
+	using CounterMap = std::map<const std::string*, Counter>;
+private:
+	static inline std::atomic<size_t> current_ {0}, peak_ {0}, watermark_ {0};
+	static inline std::atomic<Counter*> counter_ {nullptr};
+	static inline CounterMap commands_ {};
+	static void Raise(std::atomic<size_t>& value, size_t candidate) noexcept {
+		size_t old {value.load(std::memory_order_relaxed)};
+		while ((candidate > old) && !value.compare_exchange_weak(old, candidate, std::memory_order_relaxed));
+	}
+public:
+	static void Allocate(size_t bytes) noexcept {
+		const size_t now {current_.fetch_add(bytes, std::memory_order_relaxed) + bytes};
+		Raise(peak_, now);
+		Raise(watermark_, now);
+		if (bytes >= LargeAllocation)
+			if (Counter* counter {counter_.load(std::memory_order_relaxed)}) {
+				counter->count.fetch_add(1, std::memory_order_relaxed);
+				counter->bytes.fetch_add(bytes, std::memory_order_relaxed);
+			}
+	}
+	static void Deallocate(size_t bytes) noexcept {
+		current_.fetch_sub(bytes, std::memory_order_relaxed);
+	}
+	static size_t current() noexcept {return current_.load();}
+	static size_t peak() noexcept {return peak_.load();}
+	static const CounterMap& commands() noexcept {return commands_;}
+	class CommandScope { // attributes sample allocations to the innermost running command
+	private:
+		Counter* previous_;
+		size_t start_, previous_watermark_;
+	public:
+		explicit CommandScope(const std::string* command) :
+				previous_{counter_.load()}, start_{current_.load()}, previous_watermark_{watermark_.load()} {
+			counter_ = &commands_[command];
+			watermark_ = start_;
+		}
+		~CommandScope() {
+			Counter* counter {counter_.load()};
+			counter->calls++;
+			Raise(counter->peak, watermark_.load() - start_);
+			Raise(watermark_, previous_watermark_);
+			counter_ = previous_;
+		}
+		CommandScope(const CommandScope&) = delete;
+		CommandScope& operator=(const CommandScope&) = delete;
+	};
+};
+
+template <typename T>
+class CountingAllocator {
+public:
+	using value_type = T;
+	CountingAllocator() noexcept = default;
+	template <typename U>
+	CountingAllocator(const CountingAllocator<U>&) noexcept {}
+	T* allocate(size_t count) {
+		T* data {std::allocator<T>{}.allocate(count)};
+		MemoryStats::Allocate(count * sizeof(T));
+		return data;
+	}
+	void deallocate(T* data, size_t count) noexcept {
+		MemoryStats::Deallocate(count * sizeof(T));
+		std::allocator<T>{}.deallocate(data, count);
+	}
+	template <typename U>
+	bool operator==(const CountingAllocator<U>&) const noexcept {return true;}
+};
+
+} //end namespace BoxyLady
+
+#endif /* MEMORY_H_ */
@@ -0,0 +1,77 @@
+//============================================================================
+// Name        : BoxyLady
+// Author      : Darren Green
+// Copyright   : (C) Darren Green 2011-2025
+// Description : Music sequencer
+//
+// License GPLv3+: GNU GPL version 3 or later <http://gnu.org/licenses/gpl.html>
+// This is free software; you are free to change and redistribute it.
+// There is NO WARRANTY, to the extent permitted by law.
+// Contact: darren.green@stir.ac.uk http://pinkmongoose.co.uk
+//============================================================================
+
+
+#include <array>
+#include <cmath>
+#include <utility>
+
+#include "Noise.h"
+#include "Waveform.h"
+
+namespace BoxyLady {
+
+// Positive poles are given at 44.1 kHz and moved to keep their corner
+// frequencies, with weights rescaled to keep each section's DC gain.
+void NoiseFilter::AddSection(float_type pole, float_type weight, float_type sample_rate) {
+	if (pole > 0.0_flt) {
+		const float_type moved {pow(pole, 44100.0_flt / sample_rate)};
+		weight *= (1.0_flt - moved) / (1.0_flt - pole);
+		pole = moved;
+	}
+	sections_.push_back({pole, weight});
+}
+
+NoiseFilter::NoiseFilter(noise_colour colour, float_type sample_rate) {
+	constexpr std::array<std::pair<float_type, float_type>, 6> Kellet {{{0.99886, 0.0555179},
+		{0.99332, 0.0750759}, {0.96900, 0.1538520}, {0.86650, 0.3104856}, {0.55000, 0.5329522},
+		{-0.7616, -0.0168980}}};
+	switch (colour) {
+	case noise_colour::pink:
+	case noise_colour::blue:
+		// Paul Kellet's refined pink filter, within 0.05 dB of -3 dB/octave
+		// above 9 Hz; blue is its first difference.
+		for (const auto& [pole, weight] : Kellet)
+			AddSection(pole, weight, sample_rate);
+		direct_ = 0.5362;
+		delayed_ = 0.115926;
+		difference_ = (colour == noise_colour::blue);
+		break;
+	case noise_colour::brown: {
+		// (1 - z^-1) / ((1 - p z^-1)(1 - q z^-1)) in partial fractions:
+		// -6 dB/octave above 25 Hz, flat down to 5 Hz, no DC.
+		const float_type p {exp(-physics::TwoPi * 5.0_flt / sample_rate)},
+			q {exp(-physics::TwoPi * 25.0_flt / sample_rate)};
+		sections_.push_back({p, (p - 1.0_flt) / (p - q)});
+		sections_.push_back({q, (q - 1.0_flt) / (q - p)});
+		break;
+	}
+	case noise_colour::violet:
+		direct_ = 1.0;
+		difference_ = true;
+		break;
+	}
+	NoiseFilter impulse {*this};
+	double energy {0.0};
+	for (size_t index {0}; index < static_cast<size_t>(sample_rate) * 10; index++) {
+		const double response {impulse.Step(index ? 0.0_flt : 1.0_flt)};
+		energy += response * response;
+		float_type tail {0.0};
+		for (const Section& section : impulse.sections_)
+			tail += std::abs(section.state);
+		if ((index > 2) && (tail < 1e-9_flt))
+			break;
+	}
+	gain_ = static_cast<float_type>(1.0 / std::sqrt(energy));
+}
+
+} //end namespace BoxyLady
@@ -0,0 +1,63 @@
+//============================================================================
+// Name        : BoxyLady
+// Author      : Darren Green
+// Copyright   : (C) Darren Green 2011-2025
+// Description : Music sequencer
+//
+// License GPLv3+: GNU GPL version 3 or later <http://gnu.org/licenses/gpl.html>
+// This is free software; you are free to change and redistribute it.
+// There is NO WARRANTY, to the extent permitted by law.
+// Contact: darren.green@stir.ac.uk http://pinkmongoose.co.uk
+//============================================================================
+
+
+#ifndef NOISE_H_
+#define NOISE_H_
+
+#include <vector>
+
+#include "Global.h"
+
+namespace BoxyLady {
+
+enum class noise_colour {
+	pink, brown, blue, violet
+};
+
+// Shapes unit-variance white noise into a colour with unit variance. The
+// shaping is a sum of one-pole sections plus direct and one-sample-delayed
+// terms, optionally differenced; the gain is set from the filter's own
+// impulse response.
+class NoiseFilter {
+private:
+	struct Section {
+		float_type pole, weight, state {0.0};
+	};
+	std::vector<Section> sections_;
+	float_type direct_ {0.0}, delayed_ {0.0}, gain_ {1.0}, last_input_ {0.0}, last_output_ {0.0};
+	bool difference_ {false};
+	void AddSection(float_type pole, float_type weight, float_type sample_rate);
+	float_type Step(float_type input) noexcept {
+		float_type value {direct_ * input + delayed_ * last_input_};
+		last_input_ = input;
+		for (Section& section : sections_) {
+			section.state = section.pole * section.state + section.weight * input;
+			value += section.state;
+		}
+		if (difference_) {
+			const float_type change {value - last_output_};
+			last_output_ = value;
+			return change;
+		}
+		return value;
+	}
+public:
+	explicit NoiseFilter(noise_colour, float_type sample_rate);
+	float_type operator()(float_type input) noexcept {
+		return Step(input) * gain_;
+	}
+};
+
+} //end namespace BoxyLady
+
+#endif /* NOISE_H_ */
@@ -0,0 +1,56 @@
+//============================================================================
+// Name        : BoxyLady
+// Author      : Darren Green
+// Copyright   : (C) Darren Green 2011-2025
+// Description : Music sequencer
+//
+// License GPLv3+: GNU GPL version 3 or later <http://gnu.org/licenses/gpl.html>
+// This is free software; you are free to change and redistribute it.
+// There is NO WARRANTY, to the extent permitted by law.
+// Contact: darren.green@stir.ac.uk http://pinkmongoose.co.uk
+//============================================================================
+
+#ifndef PARALLEL_H_
+#define PARALLEL_H_
+
+#include <algorithm>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace BoxyLady {
+
+inline size_t HardwareThreads() noexcept {
+	return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Runs op(index) for every index in [0, count), spread over up to `threads`
+// threads. The first exception thrown by any task is rethrown on the caller.
+template <typename Operation>
+void ParallelFor(size_t count, size_t threads, Operation op) {
+	threads = std::min(threads, count);
+	if (threads <= 1) {
+		for (size_t index {0}; index < count; index++)
+			op(index);
+		return;
+	}
+	std::vector<std::exception_ptr> errors(threads);
+	{
+		std::vector<std::jthread> workers;
+		for (size_t thread {0}; thread < threads; thread++)
+			workers.emplace_back([&op, &errors, count, threads, thread] {
+				try {
+					for (size_t index {thread}; index < count; index += threads)
+						op(index);
+				} catch (...) {
+					errors[thread] = std::current_exception();
+				}
+			});
+	}
+	for (const auto& error : errors)
+		if (error) std::rethrow_exception(error);
+}
+
+} //end namespace BoxyLady
+
+#endif /* PARALLEL_H_ */
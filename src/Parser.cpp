@@ -10,15 +10,20 @@
 // Contact: darren.green@stir.ac.uk http://pinkmongoose.co.uk
 //============================================================================
 
+#include <array>
 #include <fstream>
 #include <tuple>
 #include <filesystem>
 #include <functional>
+#include <iterator>
+#include <memory>
 #include <utility>
 
 #include "Parser.h"
 #include "Sound.h"
 #include "Platform.h"
+#include "Memory.h"
+#include "Parallel.h"
 
 namespace BoxyLady {
 
@@ -42,7 +47,7 @@ const std::string VersionNumber{"0.2.5"},
 	VersionAlias{"Mephitic Mathmo"},
 	Version{VersionNumber + " " + VersionAlias + "."},
 	BootWelcome{"print(\"Welcome to BoxyLady. This is BoxyLady.\")\n"},
-	BootHelp{"Usage: BoxyLady --help --version --noboot --portable --envshow --messages MESSAGELEVEL --interactive --outer 'SOURCE' --quick 'SOURCE' SOURCEFILE\n"},
+	BootHelp{"Usage: BoxyLady --help --version --noboot --portable --envshow --messages MESSAGELEVEL --image IMAGEFILE --memstats --interactive --outer 'SOURCE' --quick 'SOURCE' SOURCEFILE\n"},
 	BootLicence{"Copyright (C) 2011-2025 Darren Green.\nLicense GPLv3+: GNU GPL version 3 or later <http://gnu.org/licenses/gpl.html>\n\n\
 This is free software; you are free to change and redistribute it.\n\
 There is NO WARRANTY, to the extent permitted by law.\n\n"},
@@ -220,6 +225,9 @@ void Parser::Clear() {
 	dictionary_.Insert(DictionaryItem(dic_item_type::macro), ":beep")
 			.Protect(dic_item_protection::locked).getMacro().Parse("\\:triangle");
 	verbosity_  = verbosity_type::messages;
+	global_history_ = Blob {};
+	memory_limit_ = 0.0;
+	sound_holds_ = 0;
 	default_sample_rate_ = 44100;
 	instrument_sample_rate_ = 0;
 	instrument_duration_ = 1.0,
@@ -247,6 +255,7 @@ void Parser::GlobalDefaults(Blob& blob) {
 	params_.mode_ = context_mode::seq;
 	Sound temp_sound;
 	NotesModeBlob(blob, temp_sound, params_, 0.0, false);
+	global_history_.children_.push_back(blob);
 }
 
 void Parser::QuickMusic(Blob& blob) {
@@ -263,6 +272,7 @@ void Parser::QuickMusic(Blob& blob) {
 	DictionaryMutex mutex {slot};
 	Sound& sound {slot.getSound()};
 	sound.CreateSilenceSeconds(StereoChannels, default_sample_rate_, 0, 0);
+	SoundHold hold {sound_holds_};
 	const float_type context_length {NotesModeBlob(blob, sound, params, start, true)};
 	if (sound.p_samples() == 0) return;
 	sound.set_tSeconds(context_length);
@@ -295,6 +305,7 @@ void Parser::MakeMusic(Blob& blob) {
 		throw EError("No instruction block provided.\n" + blob.ErrorString());
 	sound.CreateSilenceSeconds(channels, sample_type.sample_rate, 0, 0);
 	sound.setType(sample_type);
+	SoundHold hold {sound_holds_};
 	const float_type context_length {NotesModeBlob(music_blob, sound, params, start, true)};
 	sound.set_tSeconds(context_length);
 	DoMessage("Created patch [" + name + "]");
@@ -626,7 +637,7 @@ void Parser::PlayNote(std::string token, Blob& blob, Sound& sound,
 		std::string instrument {params.instrument_};
 		if (instrument == "")
 			throw EError("No instrument specified to use.\n" + blob.ErrorString());
-		DictionaryItem& instrument_item {dictionary_.Find(instrument)};
+		DictionaryItem& instrument_item {dictionary_.Find(instrument_handle_, instrument)};
 		if (instrument_item.isNull())
 			throw EError(instrument + ": No such object.");
 		const float_type freq_mult_standard {params.gamut_.FreqMultStandard(note_value)},
@@ -659,7 +670,7 @@ void Parser::PlayNote(std::string token, Blob& blob, Sound& sound,
 		SampleType instrument_sound_type {instrument_sound.getType()};
 		Scratcher scratcher {articulation.scratcher_};
 		if (scratcher.active()) {
-			DictionaryItem& scratcher_item {dictionary_.Find(scratcher.name())};
+			DictionaryItem& scratcher_item {dictionary_.Find(scratcher_handle_, scratcher.name())};
 			if (scratcher_item.isNull())
 				throw EError("Failed to find 'scratch' slot." + blob.ErrorString());
 			if (!scratcher_item.isSound())
@@ -714,7 +725,7 @@ void Parser::PlayNote(std::string token, Blob& blob, Sound& sound,
 //			process_flags[overlay::resize] = true;
 			if (reverb)
 				throw EError("Post_process with reverb does not work. " + blob.ErrorString());
-			DictionaryItem& process_item {dictionary_.Find(params.post_process_)};
+			DictionaryItem& process_item {dictionary_.Find(process_handle_, params.post_process_)};
 			if (process_item.isNull())
 				throw EError("Failed to find 'post_process' slot." + blob.ErrorString());
 			Sound& process_sound {dictionary_.InsertSound("note")};
@@ -1097,7 +1108,7 @@ void Parser::Mingle(Blob &blob) {
 	Blob& destination {GetMutableBlob(blob["@"].atom(),blob,true)};
 	for (auto& source_item : source_list.children_) {
 		const std::string source_name {source_item.atom()};
-		DictionaryItem item {dictionary_.Find(source_name)};
+		DictionaryItem& item {dictionary_.Find(source_name)};
 		if (!item.isMacro()) throw EError("Source variable '"+source_name+"' not a macro.\n" + blob.ErrorString());
 		Blob& macro {item.getMacro()};
 		if (macro.children_.size() < 1) throw EError("Source variable '"+source_name+"' not long enough\n" + blob.ErrorString());
@@ -1111,7 +1122,7 @@ void Parser::Mingle(Blob &blob) {
 	destination.children_.clear();
 	for (int i=0; i<sample_size; i++)
 		for (size_t j=0; j<sources.size(); j++) {
-			destination.children_.push_back(sources[j].children_[position[j]]);
+			destination.children_.Append(sources[j].children_, position[j], position[j] + 1);
 			position[j]++;
 			if (position[j]>=sources[j].children_.size())
 				position[j]=0;
@@ -1124,33 +1135,39 @@ void Parser::Rotate(Blob &blob) {
 	size_t n {1};
 	if (!size) EError("Source for rotate not long enough\n" + blob.ErrorString());
 	if (blob.hasKey("n")) n = static_cast<size_t>(blob["n"].asInt(1, size));
+	auto Rotated = [&change, size](size_t first) {
+		Blob::ChildList rotated {change.children_.Slice(first, size)};
+		rotated.Append(change.children_, 0, first);
+		return rotated;
+	};
 	if (blob.hasFlag("drop_front"))
-		change.children_.erase(change.children_.begin(), change.children_.begin() + n);
+		change.children_ = change.children_.Slice(n, size);
 	else if (blob.hasFlag("drop_back"))
-		change.children_.resize(change.children_.size() - n);
+		change.children_ = change.children_.Slice(0, size - n);
 	else if (blob.hasFlag("rotate_front"))
-		std::rotate(change.children_.begin(), change.children_.begin() + n, change.children_.end());
+		change.children_ = Rotated(n);
 	else if (blob.hasFlag("rotate_back"))
-		std::rotate(change.children_.rbegin(), change.children_.rbegin() + n, change.children_.rend());
+		change.children_ = Rotated(size - n);
 }
 
 void Parser::Replicate(Blob &blob) {
 	Blob& change {GetMutableBlob(blob["@"].atom(), blob, false)};
 	const int n {blob["n"].asInt(1, int_max)};
 	const bool cycle {blob.hasFlag("cycle")};
+	const size_t size {change.children_.size()};
 	Blob temp;
 	if (cycle) for (int i=0; i<n; i++)
-		for (auto& item: change.children_) temp.children_.push_back(item);
-	else for (auto& item : change.children_)
-		for (int i=0; i<n; i++) temp.children_.push_back(item);
-	change.children_ = temp.children_;
+		temp.children_.Append(change.children_, 0, size);
+	else for (size_t item {0}; item < size; item++)
+		for (int i=0; i<n; i++) temp.children_.Append(change.children_, item, item + 1);
+	change.children_ = std::move(temp.children_);
 }
 
 void Parser::Indirect(Blob &blob) {
 	Blob& change {GetMutableBlob(blob["@"].atom(), blob, true)};
 	change.children_.clear();
-	DictionaryItem from_item {dictionary_.Find(blob["from"].atom())},
-		index_item {dictionary_.Find(blob["indices"].atom())};
+	DictionaryItem& from_item {dictionary_.Find(blob["from"].atom())},
+		&index_item {dictionary_.Find(blob["indices"].atom())};
 	if (!from_item.isMacro()) throw EError("From variable is not a macro." + blob.ErrorString());
 	if (!index_item.isMacro()) throw EError("Index variable is not a macro." + blob.ErrorString());
 	Blob& from {from_item.getMacro()};
@@ -1158,7 +1175,7 @@ void Parser::Indirect(Blob &blob) {
 	const size_t max_item {from.children_.size()};
 	for (auto& index_string : indices.children_) {
 		const int index {index_string.asInt(1,max_item)};
-		change.children_.push_back(from[index-1]);
+		change.children_.Append(from.children_, index - 1, index);
 	}
 }
 
@@ -1342,7 +1359,7 @@ void Parser::LoadLibrary(std::string file_name, verbosity_type verbosity, bool i
 	if (file.is_open()) {
 		Blob blob;
 		DoMessage("<parsing " + file_name + ">", verbosity);
-		blob.Parse(file);
+		blob.ParseLibrary(std::make_shared<const std::string>(std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}));
 		file.close();
 		ParseBlobs(blob);
 		//Message("<finished " + file_name + ">");
@@ -1379,6 +1396,8 @@ Parser::parse_exit Parser::ParseImmediate() {
 Parser::parse_exit Parser::ParseBlobs(Blob& blob) {
 	parse_exit exit_code {parse_exit::exit};
 	for (auto& instruction : blob.children_) {
+		if ((memory_limit_ > 0.0) && !sound_holds_)
+			dictionary_.Spill(static_cast<size_t>(memory_limit_ * MegaByte));
 		if (instruction.isToken()) {
 			std::string token {instruction.val_};
 			if (token[0] == '\\') {
@@ -1396,6 +1415,7 @@ Parser::parse_exit Parser::ParseBlobs(Blob& blob) {
 			throw EError(token + ": Unknown command. () missing?\n" + blob.ErrorString());
 		}
 		instruction.AssertFunction();
+		const MemoryStats::CommandScope memory_scope {instruction.key_.id()};
 		if (const auto token {instruction.key_}; token == "exit") {
 			exit_code = parse_exit::end;
 			break;
@@ -1420,6 +1440,10 @@ Parser::parse_exit Parser::ParseBlobs(Blob& blob) {
 			//do nothing
 		} else if (token == "source")
 			LoadLibrary(instruction.atom(), verbosity_type::messages, false);
+		else if (token == "save_image")
+			SaveImage(instruction);
+		else if (token == "load_image")
+			LoadImage(instruction.atom());
 		else if (token == "library") {
 			try {
 				LoadLibrary(instruction.atom(), verbosity_type::errors, true);
@@ -1453,6 +1477,10 @@ Parser::parse_exit Parser::ParseBlobs(Blob& blob) {
 				dictionary_.ListEntries(instruction);
 		} else if (token == "defrag")
 			Defrag();
+		else if (token == "memory") {
+			if (verbosity_ >= verbosity_type::messages)
+				MemoryReport(instruction.hasFlag("*"));
+		}
 		else if (token == "access")
 			SetAccess(instruction);
 		else if (token == "read")
@@ -1511,6 +1539,8 @@ Parser::parse_exit Parser::ParseBlobs(Blob& blob) {
 			Balance(instruction);
 		else if (token == "reverb")
 			EchoEffect(instruction);
+		else if (token == "convolve")
+			Convolve(instruction);
 		else if (token == "karplus_strong")
 			KarplusStrong(instruction);
 		else if (token == "chowning")
@@ -1525,8 +1555,14 @@ Parser::parse_exit Parser::ParseBlobs(Blob& blob) {
 			LowPass(instruction);
 		else if (token == "highpass")
 			HighPass(instruction);
-		else if (token == "bandpass")
+		else if ((token == "bandpass") || (token == "peak"))
 			BandPass(instruction);
+		else if (token == "lowshelf")
+			Shelf(instruction, false);
+		else if (token == "highshelf")
+			Shelf(instruction, true);
+		else if (token == "notch")
+			Notch(instruction);
 		else if (token == "fourier_gain")
 			FourierGain(instruction);
 		else if (token == "fourier_bandpass")
@@ -1553,8 +1589,12 @@ Parser::parse_exit Parser::ParseBlobs(Blob& blob) {
 			FourierScale(instruction);
 		else if (token == "pitch_scale")
 			PitchScale(instruction);
+		else if (token == "time_stretch")
+			TimeStretch(instruction);
 		else if (token == "fourier_power")
 			FourierPower(instruction);
+		else if (token == "spectrogram")
+			Spectrogram(instruction);
 		else if (token == "repeat")
 			Repeat(instruction);
 		else if (token == "flags")
@@ -1580,7 +1620,7 @@ Parser::parse_exit Parser::ParseBlobs(Blob& blob) {
 		else if (token == "filter_sweep")
 			FilterSweep(instruction);
 		else
-			throw EError(token + ": Unknown command.\n" + blob.ErrorString());
+			throw EError(token.str() + ": Unknown command.\n" + blob.ErrorString());
 	}
 	return exit_code;
 }
@@ -1612,6 +1652,8 @@ void Parser::ParseConfig(Blob& blob) {
 			DefaultMetadata(instruction);
 		else if (key == "echo_shell")
 			echo_shell_ = instruction.asBool();
+		else if (key == "memory_limit")
+			memory_limit_ = instruction.asFloat(0.0, float_type_max);
 		else
 			throw EError(key + ": Unknown config setting.\n" + blob.ErrorString());
 	}
@@ -1629,6 +1671,8 @@ void Parser::ShowConfig([[maybe_unused]] Blob& blob) {
 	Print(std::format("standard_pitch = {}", standard_pitch_));
 	Print("interpolation(" + BoolToString(Sound::linear_interpolation) + ")");
 	Print("echo_shell(" + BoolToString(echo_shell_) + ")");
+	Print(std::format("memory_limit = {} (resident {:.3f})", memory_limit_,
+		static_cast<float_type>(dictionary_.ResidentBytes()) / MegaByte));
 	screen.PrintSeparatorSub();
 	Print("--supervisor(" + BoolToString(supervisor_) + ")");
 	Print("--portable(" + BoolToString(portable_) + ")");
@@ -1636,6 +1680,103 @@ void Parser::ShowConfig([[maybe_unused]] Blob& blob) {
 	Sound::default_metadata_.Dump(true);
 }
 
+void Parser::MemoryReport(bool all) {
+	auto Print = [](std::string item) {screen.PrintWrap(item, Screen::PrintFlags({Screen::print_flag::frame, Screen::print_flag::wrap, Screen::print_flag::indent}));};
+	auto Mb = [](size_t bytes) {return static_cast<float_type>(bytes) / MegaByte;};
+	dictionary_.ListMemory(all);
+	const size_t macro_bytes {dictionary_.MacroBytes()}, history_bytes {global_history_.MemoryBytes()};
+	screen.PrintHeader("Memory");
+	Print(std::format("samples: current {:.3f} Mb, peak {:.3f} Mb", Mb(MemoryStats::current()), Mb(MemoryStats::peak())));
+	Print(std::format("dictionary: resident {:.3f} Mb, {} Sounds paged out", Mb(dictionary_.ResidentBytes()),
+		dictionary_.PagedOut()));
+	Print(std::format("blobs: macros {:.3f} Mb, global history {:.3f} Mb", Mb(macro_bytes), Mb(history_bytes)));
+	Print(std::format("defrag() would reclaim {:.3f} Mb", Mb(dictionary_.SlackBytes())));
+	screen.PrintSeparatorSub();
+	Print(std::format("Allocations of {} kb or more, by command:", MemoryStats::LargeAllocation / 1024));
+	std::vector<std::pair<const std::string*, const MemoryStats::Counter*>> commands;
+	for (const auto& [command, counter] : MemoryStats::commands())
+		if (counter.count)
+			commands.emplace_back(command, &counter);
+	std::ranges::sort(commands, {}, [](const auto& entry) -> const std::string& {return *entry.first;});
+	for (const auto& [command, counter] : commands)
+		Print(std::format("{}(): {} calls, {} allocations, {:.3f} Mb total, {:.3f} Mb peak", *command,
+			counter->calls.load(), counter->count.load(), Mb(counter->bytes), Mb(counter->peak)));
+	screen.PrintSeparatorBot();
+}
+
+void Parser::SaveImage(Blob& blob) {
+	const std::string file_name {blob.atom()};
+	// Spilled Sounds are copied straight from their pages, except those paged
+	// from the very image about to be overwritten.
+	dictionary_.Apply([&file_name](DictionaryItem& item) {
+		if (item.isSound() && item.getSound().isPagedFrom(file_name))
+			item.getSound().PageIn();
+	});
+	ImageWriter image {file_name};
+	image.WriteString(ImageMagic);
+	const std::streamoff index_slot {image.Tell()};
+	image.Write(static_cast<int64_t>(0));
+	const std::vector<ImagePage> pages {dictionary_.WriteImageSamples(image)};
+	const std::streamoff index_offset {image.Tell()};
+	dictionary_.WriteImageIndex(image, pages);
+	image.Write(static_cast<uint64_t>(default_sample_rate_));
+	for (double value : {max_instrument_duration_, standard_pitch_, Sound::linear_interpolation})
+		image.Write(value);
+	for (auto& command : {file_play_, terminal_, mp3_encoder_, ls_})
+		image.WriteString(command);
+	image.Write(static_cast<uint8_t>(echo_shell_));
+	Sound::default_metadata_.WriteImage(image);
+	image.WriteString(Rand.State());
+	image.WriteBlob(global_history_);
+	image.Seek(index_slot);
+	image.Write(static_cast<int64_t>(index_offset));
+	image.Close();
+	TryMessage("Saved image `" + file_name + "`", blob);
+}
+
+void Parser::LoadImage(std::string file_name) {
+	ImageReader image {file_name};
+	if (image.ReadString() != ImageMagic)
+		throw EError("Opening image [" + file_name + "]: Not a BoxyLady image.");
+	image.Seek(image.Read<int64_t>());
+	// Everything is read before anything is replaced, so a truncated or
+	// corrupt image leaves the session as it was.
+	Dictionary dictionary;
+	dictionary.ReadImage(image);
+	const uint64_t sample_rate {image.Read<uint64_t>()};
+	std::array<double, 3> values;
+	for (double& value : values)
+		value = image.Read<double>();
+	std::array<std::string, 4> commands;
+	for (std::string& command : commands)
+		command = image.ReadString();
+	const uint8_t echo_shell {image.Read<uint8_t>()};
+	MetadataList metadata;
+	metadata.ReadImage(image);
+	auto random {Rand};
+	if (!random.setState(image.ReadString()))
+		throw EError("Image [" + file_name + "]: Bad random number state.");
+	Blob history;
+	image.ReadBlob(history);
+	dictionary_.Clear();
+	dictionary_.Merge(std::move(dictionary));
+	default_sample_rate_ = sample_rate;
+	auto value {values.begin()};
+	for (float_type* target : {&max_instrument_duration_, &standard_pitch_, &Sound::linear_interpolation})
+		*target = *value++;
+	auto command {commands.begin()};
+	for (std::string* target : {&file_play_, &terminal_, &mp3_encoder_, &ls_})
+		*target = std::move(*command++);
+	echo_shell_ = echo_shell;
+	Sound::default_metadata_ = std::move(metadata);
+	Rand = random;
+	params_ = ParseParams();
+	global_history_ = Blob {};
+	for (auto& global : history.children_)
+		GlobalDefaults(global);
+	DoMessage("<restored image " + file_name + ">", verbosity_type::messages);
+}
+
 void Parser::ReadCIN(Blob& blob) {
 	const std::string name {blob.atom()};
 	std::string input;
@@ -1648,10 +1789,10 @@ void Parser::ReadCIN(Blob& blob) {
 void Parser::MakeMacro(Blob& blob, macro_type type, bool allow_replace) {
 	std::string name;
 	for (auto& macro_blob : blob.children_) {
-		const auto name {macro_blob.key_};
+		const std::string name {macro_blob.key_};
 		if (dictionary_.contains(name)) {
 			if (!allow_replace) throw EError(name + ": Object already exists.");
-			DictionaryItem item {dictionary_.Find(name)};
+			DictionaryItem& item {dictionary_.Find(name)};
 			if (item.getType()!=dic_item_type::macro) throw EError(name + ": Object must be a macro.");
 			if (item.getMacroType()!=type) throw EError(name + ": Cannot replace different type of macro.");
 			dictionary_.Delete(name);
@@ -2056,7 +2197,7 @@ void Parser::Resize(Blob& blob) {
 
 void Parser::Defrag() {
 	dictionary_.Apply([](DictionaryItem& item) {
-		if (item.isSound())
+		if (item.isSound() && item.getSound().isResident())
 			item.getSound().Defrag();
 	});
 }
@@ -2067,7 +2208,7 @@ void Parser::SetAccess(Blob& blob) {
 		verbosity = BuildVerbosity(blob["shh!"].atom());
 	for (auto& child : blob.children_) {
 		if (child.key_ == "shh!") continue;
-		const auto name {child.key_}, atom {child.atom()};
+		const std::string name {child.key_}, atom {child.atom()};
 		DictionaryItem& item {dictionary_.Find(name)};
 		if (item.isNull())
 			throw EError(name + ": No such object.");
@@ -2179,12 +2320,45 @@ void Parser::Balance(Blob& blob) {
 void Parser::EchoEffect(Blob& blob) {
 	const float_type delay {blob["delay"].asFloat()},
 		amp {BuildAmplitude(blob["a"])};
-	const int count {(blob.hasKey("n")) ? blob["n"].asInt(1, 1000) : 1};
-	const bool resize {blob.hasFlag("resize")};
+	const bool resize {blob.hasFlag("resize")}, pingpong {blob.hasFlag("pingpong")},
+		feedback {pingpong || blob.hasFlag("feedback")};
 	FilterVector filters;
 	if (blob.hasKey("filter"))
 		filters = BuildFilters(blob["filter"]);
-	dictionary_.FindSound(blob).EchoEffect(delay, amp, count, filters, resize);
+	if (feedback) {
+		const int count {(blob.hasKey("n")) ? blob["n"].asInt(1, 1000000) : 0};
+		dictionary_.FindSound(blob).FeedbackEcho(delay, amp, count, filters, resize, pingpong);
+	} else {
+		const int count {(blob.hasKey("n")) ? blob["n"].asInt(1, 1000) : 1};
+		dictionary_.FindSound(blob).EchoEffect(delay, amp, count, filters, resize);
+	}
+}
+
+void Parser::Convolve(Blob& blob) {
+	const float_type wet {blob.hasKey("wet") ? BuildAmplitude(blob["wet"]) : 1.0_flt},
+		dry {blob.hasKey("dry") ? BuildAmplitude(blob["dry"]) : 0.0_flt};
+	const size_t block {blob.hasKey("block") ? static_cast<size_t>(blob["block"].asInt(16, 1 << 20)) : 0},
+		threads {blob.hasKey("threads") ? static_cast<size_t>(blob["threads"].asInt(0, 1024)) : 1};
+	std::string impulse_name {blob["ir"].atom()};
+	if (impulse_name.starts_with('@'))
+		impulse_name.erase(0, 1);
+	const Sound& impulse {dictionary_.FindSound(impulse_name)};
+	dictionary_.FindSound(blob).Convolve(impulse, wet, dry, blob.hasFlag("resize"), block,
+		threads ? threads : HardwareThreads(), blob.hasFlag("direct"));
+}
+
+void Parser::PitchScale(Blob& blob) {
+	const size_t frame {blob.hasKey("frame") ? static_cast<size_t>(blob["frame"].asInt(16, 1 << 20)) : 0},
+		overlap {blob.hasKey("overlap") ? static_cast<size_t>(blob["overlap"].asInt(2, 64)) : 0},
+		threads {blob.hasKey("threads") ? static_cast<size_t>(blob["threads"].asInt(0, 1024)) : 0};
+	dictionary_.FindSound(blob).PitchScale(blob["f"].asFloat(0.001, 1000.0), frame, overlap, threads);
+}
+
+void Parser::TimeStretch(Blob& blob) {
+	const size_t frame {blob.hasKey("frame") ? static_cast<size_t>(blob["frame"].asInt(16, 1 << 20)) : 0},
+		overlap {blob.hasKey("overlap") ? static_cast<size_t>(blob["overlap"].asInt(2, 64)) : 0},
+		threads {blob.hasKey("threads") ? static_cast<size_t>(blob["threads"].asInt(0, 1024)) : 0};
+	dictionary_.FindSound(blob).TimeStretch(blob["f"].asFloat(0.01, 100.0), frame, overlap, threads);
 }
 
 void Parser::Tremolo(Blob& blob) {
@@ -2214,8 +2388,14 @@ Filter Parser::BuildFilter(Blob& blob) const {
 		return BuildLowPass(blob);
 	else if (token == "highpass")
 		return BuildHighPass(blob);
-	else if (token == "bandpass")
+	else if ((token == "bandpass") || (token == "peak"))
 		return BuildBandPass(blob);
+	else if (token == "lowshelf")
+		return BuildShelf(blob, false);
+	else if (token == "highshelf")
+		return BuildShelf(blob, true);
+	else if (token == "notch")
+		return BuildNotch(blob);
 	else if (token == "amp")
 		return Filter::Amp(BuildAmplitude(blob));
 	else if (token == "distort")
@@ -2240,7 +2420,7 @@ Filter Parser::BuildFilter(Blob& blob) const {
 		return BuildPitchScale(blob);
 	else if (token == "inverse_lr")
 		return Filter::InverseLR();
-	else throw EError(token + ": Unknown filter type.");
+	else throw EError(token.str() + ": Unknown filter type.");
 }
 
 FilterVector Parser::BuildFilters(Blob& blob) const {
@@ -2252,12 +2432,16 @@ FilterVector Parser::BuildFilters(Blob& blob) const {
 }
 
 Filter Parser::BuildLowPass(Blob& blob) const {
+	if (blob.hasKey("f"))
+		return BuildButterworth(blob, false);
 	const float_type r {blob["r"].asFloat(1.0, 1000000.0)};
 	const bool wrap {blob.hasFlag("wrap")};
 	return Filter::LowPass(r, wrap);
 }
 
 Filter Parser::BuildHighPass(Blob& blob) const {
+	if (blob.hasKey("f"))
+		return BuildButterworth(blob, true);
 	const float_type r {blob["r"].asFloat(1.0, 1000000.0)};
 	const bool wrap {blob.hasFlag("wrap")};
 	return Filter::HighPass(r, wrap);
@@ -2274,6 +2458,34 @@ Filter Parser::BuildBandPass(Blob& blob) const {
 	return Filter::BandPass(frequency, bandwidth, log10(gain) * dBperlog10, wrap);
 }
 
+Filter Parser::BuildButterworth(Blob& blob, bool high) const {
+	const float_type frequency {blob["f"].asFloat(0.001, 100000.0)};
+	const int order {blob.hasKey("order") ? blob["order"].asInt(1, 16) : 2};
+	const bool linkwitz_riley {blob.hasFlag("lr")}, wrap {blob.hasFlag("wrap")};
+	if (linkwitz_riley && (order % 2))
+		throw EError("Linkwitz-Riley filters need an even order.\n" + blob.ErrorString());
+	return Filter::Butterworth(frequency, order, high, linkwitz_riley, wrap);
+}
+
+Filter Parser::BuildShelf(Blob& blob, bool high) const {
+	constexpr float_type dBperlog10 {20.0};
+	const float_type frequency {blob["f"].asFloat(0.001, 100000.0)},
+		slope {blob.hasKey("slope") ? blob["slope"].asFloat(0.01, 1.0) : 1.0_flt},
+		gain {BuildAmplitude(blob["gain"])};
+	if (gain <= 0.0)
+		throw EError("Shelf filter requires non-zero, positive gain (on amplitude scale).");
+	const bool wrap {blob.hasFlag("wrap")};
+	return high ? Filter::HighShelf(frequency, slope, log10(gain) * dBperlog10, wrap)
+		: Filter::LowShelf(frequency, slope, log10(gain) * dBperlog10, wrap);
+}
+
+Filter Parser::BuildNotch(Blob& blob) const {
+	const float_type frequency {blob["f"].asFloat(0.001, 100000.0)},
+		bandwidth {blob["width"].asFloat(0.001, 100000.0)};
+	const bool wrap {blob.hasFlag("wrap")};
+	return Filter::Notch(frequency, bandwidth, wrap);
+}
+
 Filter Parser::BuildFourierGain(Blob& blob) const {
 	const float_type low_shoulder {blob["low"].asFloat(1.0, 1000000.0)},
 		low_gain {BuildAmplitude(blob["low_gain"])},
@@ -2283,7 +2495,8 @@ Filter Parser::BuildFourierGain(Blob& blob) const {
 		throw EError("Shoulders of Fourier gain filter in the wrong order.");
 	if ((low_gain <= 0.0) || (high_gain <=0.0))
 		throw EError("Fourier gain filter filter requires non-zero, positive gain (on amplitude scale).");
-	return Filter::FourierGain(low_gain, low_shoulder, high_shoulder, high_gain);
+	return Filter::FourierGain(low_gain, low_shoulder, high_shoulder, high_gain)
+		.SetFlag(filter_direction::wrap, blob.hasFlag("wrap"));
 }
 
 Filter Parser::BuildFourierBandpass(Blob& blob) const {
@@ -2293,7 +2506,8 @@ Filter Parser::BuildFourierBandpass(Blob& blob) const {
 	const bool comb {blob.hasFlag("comb")};
 	if (gain <= 0.0)
 		throw EError("Bandpass filter requires non-zero, positive gain (on amplitude scale).");
-	return Filter::FourierBandpass(frequency, bandwidth, gain).SetFlag(filter_direction::comb, comb);
+	return Filter::FourierBandpass(frequency, bandwidth, gain).SetFlag(filter_direction::comb, comb)
+		.SetFlag(filter_direction::wrap, blob.hasFlag("wrap"));
 }
 
 void Parser::FilterSweep(Blob& blob) {
@@ -2303,8 +2517,12 @@ void Parser::FilterSweep(Blob& blob) {
 		throw EError("Filter sweep needs single filter.");
 	const Filter start_filter {BuildFilter(blob["start"][0])},
 		end_filter {BuildFilter(blob["end"][0])};
-	const int window_count {blob["windows"].asInt(2, int_max)};
-	dictionary_.FindSound(blob).WindowedFilter(start_filter, end_filter, window_count);
+	const int window_count {blob.hasKey("windows") ? blob["windows"].asInt(2, int_max) : 16};
+	std::vector<float_type> curve;
+	if (blob.hasKey("curve"))
+		for (Blob& point : blob["curve"].ifFunction().children_)
+			curve.push_back(point.asFloat(0.0, 1.0));
+	dictionary_.FindSound(blob).FilterSweep(start_filter, end_filter, curve, window_count);
 }
 
 void Parser::Integrate(Blob& blob) {
@@ -2372,6 +2590,25 @@ void Parser::FourierPower(Blob& blob) {
 	dictionary_.FindSound(blob).FourierPower(power);
 }
 
+void Parser::Spectrogram(Blob& blob) {
+	const auto name {blob["@"].atom()};
+	const size_t frame {blob.hasKey("frame") ? static_cast<size_t>(blob["frame"].asInt(16, 1 << 20)) : 0},
+		hop {blob.hasKey("hop") ? static_cast<size_t>(blob["hop"].asInt(1, 1 << 20)) : 0},
+		threads {blob.hasKey("threads") ? static_cast<size_t>(blob["threads"].asInt(0, 1024)) : 0};
+	std::string file_name {""}, format_name {"csv"};
+	blob.tryWriteString("file", file_name);
+	blob.tryWriteString("format", format_name);
+	if ((format_name != "csv") && (format_name != "bin"))
+		throw EError("Spectrogram format [" + format_name + "] not recognised.");
+	const SpectralSummary summary {dictionary_.FindSound(name).Spectrogram(frame, hop, file_name,
+		format_name == "bin", blob.hasFlag("plot"), threads)};
+	screen.PrintHeader(std::string("Spectrogram of [") + name + "]");
+	summary.Print();
+	screen.PrintSeparatorBot();
+	if (!file_name.empty())
+		TryMessage("Saved spectrogram of [" + name + "] to `" + file_name + "`", blob);
+}
+
 void Parser::Repeat(Blob& blob) {
 	const int count {blob["n"].asInt(1, int_max)};
 	FilterVector filters;
@@ -2469,18 +2706,22 @@ void Parser::KarplusStrong(Blob& blob) {
 	sound.setType(SampleType(false, false, grain_type.sample_rate, 0.0));
 	if (blob.hasKey("synth"))
 		Synth(blob["synth"].ifFunction(), sound);
-	if (blob.hasKey("outer"))
+	if (blob.hasKey("outer")) {
+		SoundHold hold {sound_holds_};
 		ParseBlobs(blob["outer"].ifFunction());
+	}
 	FilterVector repeat_filters, mix_filters;
 	if (blob.hasKey("filter"))
 		repeat_filters = BuildFilters(blob["filter"]);
 	if (blob.hasKey("mix_filter"))
 		mix_filters = BuildFilters(blob["mix_filter"]);
-	sound.Repeat(int(len / grain_frequency), repeat_filters);
-	sound.ApplyFilters(mix_filters);
-	sound.Debias(Sound::debias_type::end);
-	sound.AutoResize(0.0);
-	sound.AutoAmp();
+	const float_type decay {blob.hasKey("decay") ? blob["decay"].asFloat(0.0, HourLength) : 0.0_flt},
+		damping {blob.hasKey("damping") ? blob["damping"].asFloat(0.0, 1.0) : 0.0_flt},
+		dispersion {blob.hasKey("dispersion") ? blob["dispersion"].asFloat(0.0, 0.99) : 0.0_flt},
+		pluck {blob.hasKey("pluck") ? blob["pluck"].asFloat(0.0, 1.0) : 0.0_flt};
+	const Sound& excitation {blob.hasKey("excite") ? dictionary_.FindSound(blob["excite"].atom()) : sound};
+	sound.KarplusStrong(excitation, 1.0_flt / grain_frequency, len, decay, damping, dispersion, pluck,
+		repeat_filters, mix_filters);
 	sound.setType(grain_type);
 	TryMessage("Created patch [" + name + "]", blob);
 }
@@ -2495,8 +2736,10 @@ void Parser::Chowning(Blob& blob) {
 	sound.setType(type);
 	if (blob.hasKey("synth"))
 		Synth(blob["synth"], sound);
-	if (blob.hasKey("outer"))
+	if (blob.hasKey("outer")) {
+		SoundHold hold {sound_holds_};
 		ParseBlobs(blob["outer"].ifFunction());
+	}
 	Blob& modulator_blob {blob["modulators"]};
 	for (auto& item : modulator_blob.children_)
 		Modulator(item, sound);
@@ -2614,8 +2857,14 @@ void Parser::Synth(Blob& blob, OptRef<Sound> sound_ref) {
 					sound.Waveform(wave, phaser, tone, power, synth_type::pulse, stereo);
 				else if (token == "white")
 					sound.WhiteNoise(wave.amp(), stereo);
-				else if (token == "red")
-					sound.RedNoise(wave.amp(), stereo);
+				else if (token == "pink")
+					sound.ColouredNoise(noise_colour::pink, wave.amp(), stereo);
+				else if ((token == "red") || (token == "brown"))
+					sound.ColouredNoise(noise_colour::brown, wave.amp(), stereo);
+				else if (token == "blue")
+					sound.ColouredNoise(noise_colour::blue, wave.amp(), stereo);
+				else if (token == "violet")
+					sound.ColouredNoise(noise_colour::violet, wave.amp(), stereo);
 				else if (token == "velvet")
 					sound.VelvetNoise(wave.freq(), wave.amp(), stereo);
 				else if (token == "crackle")
@@ -2627,7 +2876,7 @@ void Parser::Synth(Blob& blob, OptRef<Sound> sound_ref) {
 				else if (token == "filter")
 					sound.ApplyFilters(BuildFilters(item.ifFunction()));
 				else
-					throw EError(token + ": Unknown synth operation.");
+					throw EError(token.str() + ": Unknown synth operation.");
 			}
 		}
 	}
@@ -2655,12 +2904,10 @@ void Parser::Smatter(Sound& sound, Blob& blob) {
 }
 
 void Parser::Sines(Sound& sound, Blob& blob, float_type fundamental) {
-	for (int factor {1}; auto& item : blob.children_) {
-		const float_type amp {BuildAmplitude(item)};
-		const Wave wave(fundamental * factor, amp);
-		sound.Waveform(wave, Phaser(), Wave(), 0, synth_type::sine, Stereo());
-		factor++;
-	}
+	std::vector<float_type> amps;
+	for (auto& item : blob.children_)
+		amps.push_back(BuildAmplitude(item));
+	sound.Sines(fundamental, amps);
 }
 
 // ParseLaunch functions
@@ -2676,8 +2923,9 @@ int ParseLaunch::Start() {
 	int return_code {EXIT_SUCCESS};
 	const size_t argument_count {args_.size()};
 	try {
-		bool do_bootstrap{true}, show_environment{false}, portable{false}, show_version{false}, show_help{false};
-		std::string boot_instructions, args_instructions;
+		bool do_bootstrap{true}, show_environment{false}, portable{false}, show_version{false}, show_help{false},
+			show_memory{false};
+		std::string boot_instructions, args_instructions, image_file;
 		if (argument_count < 2)
 			boot_instructions += "print(\"BoxyLady: warning -- no arguments.\n" + BootHelp + "\")";
 		else
@@ -2701,6 +2949,10 @@ int ParseLaunch::Start() {
 					show_environment = true;
 				else if (test_arg(argument, "--messages", "-m"))
 					boot_instructions += "--messages(" + next_arg() + ")\n";
+				else if (test_arg(argument, "--image", "-I"))
+					image_file = next_arg();
+				else if (test_arg(argument, "--memstats", "-M"))
+					show_memory = true;
 				else if (test_arg(argument, "--outer", "-o"))
 					args_instructions += next_arg() + "\n";
 				else if (test_arg(argument, "--quick", "-q"))
@@ -2716,8 +2968,12 @@ int ParseLaunch::Start() {
 			if (show_version) pre_boot += "--version()\n";
 			if (show_help) pre_boot += "--help()\n";
 			if (portable) pre_boot += "--portable(T)\n";
-			boot_instructions = pre_boot + boot_instructions + "library(\"" + std::string{platform.BootLibrary()} + "\")\n";
+			boot_instructions = pre_boot + boot_instructions;
+			if (image_file.empty())
+				boot_instructions += "library(\"" + std::string{platform.BootLibrary()} + "\")\n";
 		}
+		if (!image_file.empty())
+			boot_instructions += "load_image(\"" + BackSlashEscape(image_file) + "\")\n";
 		if (show_environment) {
 			screen.PrintHeader("Environment");
 			screen.PrintMessage("boot:\n" + boot_instructions);
@@ -2725,10 +2981,16 @@ int ParseLaunch::Start() {
 			screen.PrintSeparatorBot();
 		}
 		Parser parser{};
-		parser.Supervisor(true);
-		parser.ParseString(boot_instructions);
-		parser.Supervisor(false);
-		parser.ParseString(args_instructions);
+		try {
+			parser.Supervisor(true);
+			parser.ParseString(boot_instructions);
+			parser.Supervisor(false);
+			parser.ParseString(args_instructions);
+		} catch (EError&) {
+			if (show_memory) parser.MemoryReport();
+			throw;
+		}
+		if (show_memory) parser.MemoryReport();
 	} catch (EError& error) {
 		if (!error.is_terminate()) return_code=1;
 		screen.PrintError(error);
@@ -91,8 +91,10 @@ class Parser {
 private:
 	enum class parse_exit {exit, end, error};
 	ParseParams params_;
+	Blob global_history_;
 	bool supervisor_, portable_, echo_shell_;
 	Dictionary dictionary_;
+	DictionaryHandle instrument_handle_, scratcher_handle_, process_handle_;
 	std::string mp3_encoder_, file_play_, terminal_, ls_;
 	static verbosity_type verbosity_;
 	class VerbosityScope {
@@ -104,6 +106,17 @@ private:
 		VerbosityScope(const VerbosityScope&) = delete;
     	VerbosityScope& operator=(const VerbosityScope&) = delete;
 	};
+	float_type memory_limit_;
+	int sound_holds_;
+	class SoundHold { // dictionary Sounds are referenced across nested ParseBlobs
+	private:
+		int& holds_;
+	public:
+		explicit SoundHold(int& holds) : holds_{holds} {holds_++;}
+		~SoundHold() {holds_--;}
+		SoundHold(const SoundHold&) = delete;
+		SoundHold& operator=(const SoundHold&) = delete;
+	};
 	music_size default_sample_rate_, instrument_sample_rate_;
 	float_type instrument_duration_, max_instrument_duration_, instrument_frequency_multiplier_, standard_pitch_;
 	void CheckSystem();
@@ -131,6 +144,8 @@ private:
 	void ShowPrint(Blob&);
 	void ShowConfig(Blob&);
 	void LoadLibrary(std::string, verbosity_type, bool builtin);
+	void SaveImage(Blob&);
+	void LoadImage(std::string);
 	parse_exit ParseImmediate();
 	parse_exit ParseBlobs(Blob&);
 	void ParseConfig(Blob&);
@@ -177,21 +192,30 @@ private:
 	void HighPass(Blob& blob) {
 		dictionary_.FindSound(blob).ApplyFilter(BuildHighPass(blob));
 	}
+	void Convolve(Blob&);
 	void BandPass(Blob& blob) {
 		dictionary_.FindSound(blob).ApplyFilter(BuildBandPass(blob));
 	}
+	void Shelf(Blob& blob, bool high) {
+		dictionary_.FindSound(blob).ApplyFilter(BuildShelf(blob, high));
+	}
+	void Notch(Blob& blob) {
+		dictionary_.FindSound(blob).ApplyFilter(BuildNotch(blob));
+	}
 	void FourierGain(Blob& blob) {
 		dictionary_.FindSound(blob).ApplyFilter(BuildFourierGain(blob));
 	}
 	void FourierBandpass(Blob& blob) {
 		dictionary_.FindSound(blob).ApplyFilter(BuildFourierBandpass(blob));
 	}
-	void PitchScale(Blob& blob) {
-		dictionary_.FindSound(blob).ApplyFilter(BuildPitchScale(blob));
-	}
+	void PitchScale(Blob&);
+	void TimeStretch(Blob&);
 	Filter BuildLowPass(Blob&) const;
 	Filter BuildHighPass(Blob&) const;
 	Filter BuildBandPass(Blob&) const;
+	Filter BuildShelf(Blob&, bool) const;
+	Filter BuildNotch(Blob&) const;
+	Filter BuildButterworth(Blob&, bool) const;
 	Filter BuildFourierGain(Blob&) const;
 	Filter BuildFourierBandpass(Blob&) const;
 	Filter BuildPitchScale(Blob& blob) const {
@@ -209,6 +233,7 @@ private:
 	void FourierLimit(Blob&);
 	void FourierScale(Blob&);
 	void FourierPower(Blob&);
+	void Spectrogram(Blob&);
 	void Bias(Blob&);
 	void Debias(Blob&);
 	void Flags(Blob&, Sound&);
@@ -258,6 +283,7 @@ public:
 	}
 	parse_exit ParseString(std::string);
 	void Supervisor(bool supervisor) noexcept {supervisor_ = supervisor;};
+	void MemoryReport(bool = false);
 };
 
 class ParseLaunch {
@@ -10,28 +10,89 @@
 // Contact: darren.green@stir.ac.uk http://pinkmongoose.co.uk
 //============================================================================
 
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
 #include <ctime>
-#include <random>
-#include <functional>
+#include <limits>
+#include <numbers>
+#include <span>
+#include <sstream>
+#include <string>
 
 #ifndef RANDOM_H_
 #define RANDOM_H_
 
 namespace Darren {
 
+// xoshiro256** (Blackman and Vigna), seeded through splitmix64. Satisfies
+// UniformRandomBitGenerator so it can drive the standard algorithms.
+class Xoshiro256 {
+public:
+	using result_type = std::uint64_t;
+private:
+	std::array<result_type, 4> state_;
+public:
+	static constexpr result_type SplitMix(result_type& x) noexcept {
+		result_type z {x += 0x9e3779b97f4a7c15};
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+		return z ^ (z >> 31);
+	}
+	explicit Xoshiro256(result_type seed = 0) noexcept {
+		Seed(seed);
+	}
+	void Seed(result_type seed) noexcept {
+		for (auto& word : state_)
+			word = SplitMix(seed);
+	}
+	static constexpr result_type min() noexcept {return 0;}
+	static constexpr result_type max() noexcept {return std::numeric_limits<result_type>::max();}
+	result_type operator()() noexcept {
+		const result_type result {std::rotl(state_[1] * 5, 7) * 9}, t {state_[1] << 17};
+		state_[2] ^= state_[0];
+		state_[3] ^= state_[1];
+		state_[1] ^= state_[2];
+		state_[0] ^= state_[3];
+		state_[2] ^= t;
+		state_[3] = std::rotl(state_[3], 45);
+		return result;
+	}
+	friend std::ostream& operator<<(std::ostream& stream, const Xoshiro256& generator) {
+		return stream << generator.state_[0] << ' ' << generator.state_[1] << ' '
+			<< generator.state_[2] << ' ' << generator.state_[3];
+	}
+	friend std::istream& operator>>(std::istream& stream, Xoshiro256& generator) {
+		std::array<result_type, 4> state;
+		if (!(stream >> state[0] >> state[1] >> state[2] >> state[3]))
+			return stream;
+		if (state == std::array<result_type, 4> {})
+			stream.setstate(std::ios::failbit);
+		else
+			generator.state_ = state;
+		return stream;
+	}
+};
+
+// Every draw comes from the one engine, so SetSeed fixes everything that
+// follows. Split() hands out an independent child for one operation;
+// Stream(n) gives substream n of the current seed, the same whatever was
+// drawn before, so work divided into numbered chunks does not depend on how
+// many threads share it.
 template <std::floating_point T>
 class Random {
 private:
-	inline static constexpr int DefaultSeedValue {3 * 5 * 7 * 11 * 13 * 17 * 19 * 23}; 
-	std::mt19937 generator_;
-	std::uniform_real_distribution<T> uniform_;
-	std::function<T()> Uniform01;
-public:
-	explicit Random() {
-		generator_.seed(DefaultSeedValue);
-		uniform_ = std::uniform_real_distribution<T>(0.0, 1.0);
-		Uniform01 = std::bind(uniform_, generator_);
+	inline static constexpr int DefaultSeedValue {3 * 5 * 7 * 11 * 13 * 17 * 19 * 23};
+	inline static constexpr int Digits {std::numeric_limits<T>::digits};
+	static_assert(Digits < 64);
+	Xoshiro256::result_type seed_;
+	Xoshiro256 generator_;
+	T Uniform01() noexcept {
+		return static_cast<T>(generator_() >> (64 - Digits)) * (T(1) / static_cast<T>(Xoshiro256::result_type {1} << Digits));
 	}
+public:
+	explicit Random(Xoshiro256::result_type seed = DefaultSeedValue) noexcept : seed_ {seed}, generator_ {seed} {}
 	inline T uniform() noexcept {
 		return Uniform01();
 	}
@@ -44,13 +105,56 @@ public:
 	inline bool Bernoulli(T probability) noexcept {
 		return Uniform01() < probability;
 	}
-	void SetSeed(int x) {
-		generator_.seed(x);
+	T normal(T mean = 0, T sd = 1) noexcept {
+		T pair[2];
+		FillNormal(pair, mean, sd);
+		return pair[0];
+	}
+	void Fill(std::span<T> values, T min = 0, T max = 1) noexcept {
+		for (T& value : values)
+			value = uniform(min, max);
+	}
+	// Box-Muller, two values per pair of uniforms.
+	void FillNormal(std::span<T> values, T mean = 0, T sd = 1) noexcept {
+		for (size_t index {0}; index < values.size(); index += 2) {
+			const T radius {sd * std::sqrt(T(-2) * std::log(T(1) - Uniform01()))},
+				angle {T(2) * std::numbers::pi_v<T> * Uniform01()};
+			values[index] = mean + radius * std::cos(angle);
+			if (index + 1 < values.size())
+				values[index + 1] = mean + radius * std::sin(angle);
+		}
+	}
+	Random Split() noexcept {
+		return Random {generator_()};
+	}
+	Random Stream(Xoshiro256::result_type index) const noexcept {
+		Xoshiro256::result_type mix {seed_ ^ (index * 0xd1b54a32d192ed03)};
+		return Random {Xoshiro256::SplitMix(mix)};
+	}
+	void SetSeed(int x) noexcept {
+		seed_ = static_cast<Xoshiro256::result_type>(x);
+		generator_.Seed(seed_);
+	}
+	void AutoSeed() noexcept {
+		SetSeed(static_cast<int>(std::time(nullptr)));
+	}
+	Xoshiro256& generator() noexcept {return generator_;};
+	std::string State() const {
+		std::ostringstream stream;
+		stream << seed_ << ' ' << generator_;
+		return stream.str();
 	}
-	void AutoSeed() {
-		generator_.seed(static_cast<int>(std::time(nullptr)));
+	// Leaves the engine untouched and returns false if state does not parse.
+	bool setState(const std::string& state) {
+		std::istringstream stream(state);
+		Xoshiro256::result_type seed;
+		Xoshiro256 generator;
+		if (!(stream >> seed >> generator))
+			return false;
+		seed_ = seed;
+		generator_ = generator;
+		return true;
 	}
-	std::mt19937& generator() {return generator_;};
 };
 
 } //end namespace Darren
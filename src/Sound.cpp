@@ -11,11 +11,20 @@
 //============================================================================
 
 #include "Sound.h"
-
+#include "Convolution.h"
+#include "FilterChain.h"
+#include "Delay.h"
+#include "Waveguide.h"
+#include "Vocoder.h"
+#include "Wavetable.h"
+#include "Parallel.h"
+
+#include <algorithm>
 #include <iomanip>
 #include <fstream>
 #include <sstream>
 #include <utility>
+#include <bit>
 
 namespace BoxyLady {
 
@@ -165,6 +174,27 @@ void MetadataList::WriteWavInfo(std::ofstream& file) const {
 	for (auto& item : metadata_) WriteInfoString(file, item.second.RIFF_tag, item.second.value);
 }
 
+void MetadataList::WriteImage(ImageWriter& image) const {
+	image.Write(static_cast<uint32_t>(metadata_.size()));
+	for (auto& item : metadata_) {
+		image.WriteString(item.first);
+		image.WriteString(item.second.mp3_tag);
+		image.WriteString(item.second.RIFF_tag);
+		image.WriteString(item.second.value);
+	}
+}
+
+void MetadataList::ReadImage(ImageReader& image) {
+	metadata_.clear();
+	for (uint32_t count {image.Read<uint32_t>()}; count > 0; count--) {
+		const std::string key {image.ReadString()};
+		MetadataPoint& point {metadata_[key]};
+		point.mp3_tag = image.ReadString();
+		point.RIFF_tag = image.ReadString();
+		point.value = image.ReadString();
+	}
+}
+
 //-----------------
 
 inline void accumulate(music_type& sample, float_type source) noexcept {
@@ -210,7 +240,10 @@ Filter Filter::BalanceFilters(Filter filter_a, Filter filter_b, float_type balan
 	temp.high_gain_ = GeoMean(filter_a.high_gain_, filter_b.high_gain_);
 	temp.low_shoulder_ = GeoMean(filter_a.low_shoulder_, filter_b.low_shoulder_);
 	temp.high_shoulder_ = GeoMean(filter_a.high_shoulder_, filter_b.high_shoulder_);
-	if (temp.type_ == filter_type::band)
+	temp.order_ = filter_a.order_;
+	temp.flags_[filter_direction::linkwitz_riley] = filter_a.flags_[filter_direction::linkwitz_riley];
+	temp.flags_[filter_direction::wrap] = filter_a.flags_[filter_direction::wrap] || filter_b.flags_[filter_direction::wrap];
+	if ((temp.type_ == filter_type::band) || (temp.type_ == filter_type::lo_shelf) || (temp.type_ == filter_type::hi_shelf))
 		temp.gain_ = ArithMean(filter_a.gain_, filter_b.gain_);
 	else
 		temp.gain_ = GeoMean(filter_a.gain_, filter_b.gain_);
@@ -218,6 +251,38 @@ Filter Filter::BalanceFilters(Filter filter_a, Filter filter_b, float_type balan
 	return temp;
 }
 
+BiquadCascade Filter::Cascade(music_size sample_rate) const {
+	const float_type dt {1.0_flt / static_cast<float_type>(sample_rate)},
+		w0 {physics::TwoPi * frequency_ / static_cast<float_type>(sample_rate)};
+	if ((type_ != filter_type::lo) && (type_ != filter_type::hi) && (w0 >= std::numbers::pi_v<float_type>))
+		throw EError("Filter frequency must be below the Nyquist frequency.");
+	switch (type_) {
+	case filter_type::lo: {
+		const float_type RC {1.0_flt / omega_};
+		return BiquadCascade {Biquad::OnePoleLowPass(dt / (dt + RC))};
+	}
+	case filter_type::hi: {
+		const float_type RC {1.0_flt / omega_};
+		return BiquadCascade {Biquad::OnePoleHighPass(RC / (dt + RC))};
+	}
+	case filter_type::band:
+		return BiquadCascade {Biquad::Peak(w0, bandwidth_, gain_)};
+	case filter_type::lo_shelf:
+		return BiquadCascade {Biquad::LowShelf(w0, bandwidth_, gain_)};
+	case filter_type::hi_shelf:
+		return BiquadCascade {Biquad::HighShelf(w0, bandwidth_, gain_)};
+	case filter_type::notch:
+		return BiquadCascade {Biquad::Notch(w0, bandwidth_)};
+	case filter_type::butter_lo:
+	case filter_type::butter_hi:
+		return flags_[filter_direction::linkwitz_riley] ?
+			BiquadCascade::LinkwitzRiley(w0, order_, type_ == filter_type::butter_hi) :
+			BiquadCascade::Butterworth(w0, order_, type_ == filter_type::butter_hi);
+	default:
+		return BiquadCascade {};
+	}
+}
+
 //-----------------
 
 void Sound::Clear() {
@@ -228,6 +293,7 @@ void Sound::Clear() {
 	loop_ = false;
 	start_anywhere_ = false;
 	metadata_ = default_metadata_;
+	page_.reset();
 }
 
 void Sound::CopyType(const Sound& src) noexcept {
@@ -426,6 +492,45 @@ void Sound::LoadFromFile(std::string file_name, [[maybe_unused]] file_format for
 	}
 }
 
+void Sound::WriteImageHeader(ImageWriter& image, const ImagePage& page) const {
+	image.Write(static_cast<int32_t>(channels_));
+	for (auto value : {sample_rate_, t_samples_, p_samples_, m_samples_, loop_start_samples_})
+		image.Write(static_cast<uint64_t>(value));
+	image.Write(static_cast<uint8_t>(loop_));
+	image.Write(static_cast<uint8_t>(start_anywhere_));
+	metadata_.WriteImage(image);
+	image.WritePage(page);
+}
+
+void Sound::ReadImage(ImageReader& image) {
+	Clear();
+	channels_ = image.Read<int32_t>();
+	for (auto value : {&sample_rate_, &t_samples_, &p_samples_, &m_samples_, &loop_start_samples_})
+		*value = image.Read<uint64_t>();
+	loop_ = image.Read<uint8_t>();
+	start_anywhere_ = image.Read<uint8_t>();
+	metadata_.ReadImage(image);
+	if (const ImagePage page {image.ReadPage()}; page.size > 0)
+		page_ = page;
+}
+
+void Sound::LoadPage() {
+	ImageReader::ReadSamples(*page_, music_data_);
+	page_.reset();
+}
+
+void Sound::PageOut() {
+	if (page_)
+		return;
+	const auto spill {std::make_shared<TempFilename>()};
+	ImageWriter image {spill->file_name()};
+	ImagePage page {image.WriteSamples(music_data_)};
+	image.Close();
+	page.spill = spill;
+	page_ = page;
+	MusicVector().swap(music_data_);
+}
+
 void Sound::CreateSilenceSeconds(int channels_val, music_size sample_rate_val, float_type t_time, float_type p_time) {
 	sample_rate_ = sample_rate_val;
 	CreateSilenceSamples(channels_val, sample_rate_val, Samples(t_time), Samples(p_time));
@@ -798,25 +903,141 @@ void Sound::Repeat(int count, FilterVector filters) {
 	temp.Resize(t_samples_ * count, t_samples_ * (count - 1) + p_samples_,
 			false);
 	temp.MakeSilent();
+	const FilterChain chain {filters, sample_rate_};
 	for (music_pos index {0}; index < count; index++) {
 		temp.DoOverlay(*this).start(t_samples_ * index)();
-		if (filters.size())
-			ApplyFilters(filters);
+		chain.Apply(*this);
 	}
 	*this = temp;
 }
 
+// *this is the one-period grain and sets the channels and rate. Loop filters
+// that cannot stream (Fourier, pitch_scale) fall back to repeating the grain.
+// Otherwise the string is streamed by Waveguide and the final offset removal
+// and scaling to full range are done while converting from float.
+void Sound::KarplusStrong(const Sound& excitation, float_type frequency, float_type length, float_type decay,
+		float_type damping, float_type dispersion, float_type pluck, const FilterVector& loop_filters,
+		const FilterVector& mix_filters) {
+	AssertMusic();
+	excitation.AssertMusic();
+	std::vector<float_type> blends, reverses;
+	FilterVector filters;
+	for (const Filter& filter : loop_filters)
+		if (filter.type() == filter_type::ks_blend)
+			blends.push_back(filter.gain());
+		else if (filter.type() == filter_type::ks_reverse)
+			reverses.push_back(filter.gain());
+		else
+			filters.push_back(filter);
+	const FilterChain chain {filters, sample_rate_};
+	if (!chain.isStreaming()) {
+		if (&excitation != this)
+			throw EError("Karplus-Strong: Fourier and pitch_scale loop filters need the grain as excitation.");
+		Repeat(static_cast<int>(length * frequency), loop_filters);
+		ApplyFilters(mix_filters);
+		Debias(debias_type::end);
+		AutoResize(0.0);
+		AutoAmp();
+		return;
+	}
+	if (excitation.sample_rate_ != sample_rate_)
+		throw EError("Karplus-Strong: the excitation must have the grain's sample rate.");
+	Sound source {excitation};
+	if (source.channels_ != channels_)
+		source.Rechannel(channels_);
+	const float_type gain {(decay > 0.0_flt) ? pow(0.001_flt, 1.0_flt / (frequency * decay)) : 1.0_flt};
+	const Waveguide string {static_cast<float_type>(sample_rate_) / frequency, gain, damping, dispersion, pluck,
+		std::move(blends), std::move(reverses), chain};
+	const music_size frames {Samples(length)};
+	std::vector<float_type> output;
+	string.Process(source.music_data_, source.p_samples_, output, channels_, frames, Rand.Split());
+	CreateSilenceSamples(channels_, sample_rate_, frames, frames);
+	std::vector<float_type> offsets(channels_, 0.0);
+	float_type peak {0.0};
+	if (frames)
+		for (int channel {0}; channel < channels_; channel++) {
+			offsets[channel] = output[(frames - 1) * channels_ + channel];
+			for (music_size position {0}; position < frames; position++)
+				peak = std::max(peak, std::abs(output[position * channels_ + channel] - offsets[channel]));
+		}
+	const float_type scale {(peak > 0.0_flt) ? PCMMax_f / peak : 0.0_flt};
+	for (music_size position {0}; position < frames; position++)
+		for (int channel {0}; channel < channels_; channel++)
+			music_data_[position * channels_ + channel] = static_cast<music_type>(
+				(output[position * channels_ + channel] - offsets[channel]) * scale);
+	if (!mix_filters.empty()) {
+		ApplyFilters(mix_filters);
+		Debias(debias_type::end);
+		AutoAmp();
+	}
+	AutoResize(0.0);
+}
+
 void Sound::EchoEffect(float_type offset, float_type amp, int count, FilterVector filters, bool resize) {
 	AssertMusic();
 	Sound source {*this};
 	if (resize)
 		Resize(0.0, offset * static_cast<float_type>(count), true);
+	const FilterChain chain {filters, sample_rate_};
 	for (int index {1}; index <= count; index++) {
-		source.ApplyFilters(filters);
+		chain.Apply(source);
 		DoOverlay(source).start(Samples(offset * static_cast<float_type>(index))).stereo(Stereo{pow(amp, index)})();
 	}
 }
 
+// The loop feeds back for as long as the sound lasts, so count only sets how
+// far resize extends the tail; by default, until the echo falls below one LSB.
+void Sound::FeedbackEcho(float_type offset, float_type amp, int count, const FilterVector& filters, bool resize, bool pingpong) {
+	AssertMusic();
+	const FilterChain chain {filters, sample_rate_};
+	if ((amp <= 0.0) || (amp >= 1.0))
+		throw EError("Feedback echo needs 0 < a < 1.");
+	if (channels_ > 2)
+		throw EError("Feedback echo only works on 1-2 channels.");
+	// Built before the sound is touched, so a rejected delay or chain leaves it as it was.
+	const FeedbackDelay delay {offset * static_cast<float_type>(sample_rate_), amp, chain, pingpong};
+	if (!count)
+		count = static_cast<int>(ceil(log(1.0_flt / PCMMax_f) / log(amp)));
+	if (pingpong && (channels_ == 1))
+		Rechannel(2);
+	if (resize)
+		Resize(0.0, offset * static_cast<float_type>(count), true);
+	delay.Process(music_data_, channels_, p_samples_);
+}
+
+void Sound::Convolve(const Sound& impulse, float_type wet, float_type dry, bool resize,
+		size_t block, size_t threads, bool direct) {
+	AssertMusic();
+	impulse.AssertMusic();
+	if (impulse.sample_rate_ != sample_rate_)
+		throw EError("Convolve: Impulse response must be same sample rate.");
+	std::vector<Convolver::Samples> impulses(impulse.channels_, Convolver::Samples(impulse.p_samples_));
+	for (music_size position {0}; position < impulse.p_samples_; position++)
+		for (int channel {0}; channel < impulse.channels_; channel++)
+			impulses[channel][position] = static_cast<float_type>(impulse.music_data_[position * impulse.channels_ + channel]) / PCMMax_f;
+	if (impulse.channels_ > channels_)
+		Rechannel(impulse.channels_);
+	if (resize && impulse.p_samples_)
+		Resize(music_size {0}, impulse.p_samples_ - 1, true);
+	if (!block)
+		block = Convolver::DefaultBlock(impulse.p_samples_);
+	std::vector<Convolver> convolvers;
+	if (!direct)
+		for (const auto& response : impulses)
+			convolvers.emplace_back(response, block);
+	Convolver::Samples input(p_samples_);
+	for (int channel {0}; channel < channels_; channel++) {
+		const size_t response {std::min<size_t>(channel, impulse.channels_ - 1)};
+		for (music_size position {0}; position < p_samples_; position++)
+			input[position] = static_cast<float_type>(music_data_[position * channels_ + channel]) / PCMMax_f;
+		const Convolver::Samples output {direct ? Convolver::Direct(impulses[response], input, p_samples_)
+			: convolvers[response].Process(input, p_samples_, threads)};
+		for (music_size position {0}; position < p_samples_; position++)
+			music_data_[position * channels_ + channel] = static_cast<music_type>(std::clamp(
+				(dry * input[position] + wet * output[position]) * PCMMax_f, static_cast<float_type>(PCMMin), PCMMax_f));
+	}
+}
+
 void Sound::Ring(OptRef<Sound> source_ref, Wave wave, bool distortion, float_type amp, float_type bias) {
 	AssertMusic();
 	if (source_ref.has_value()) {
@@ -878,28 +1099,47 @@ void Sound::CrackleNoise(float_type amp, Stereo stereo) {
 		}
 }
 
+// Each chunk draws from its own substream, so the noise is the same for
+// any number of threads.
 void Sound::WhiteNoise(float_type amp, Stereo stereo) {
 	AssertMusic();
-	for (music_size position {0}; position < t_samples_; position++)
-		for (int channel {0}; channel < channels_; channel++) {
-			const float_type rand {Rand.uniform()};
-			float_type value {amp * (2.0_flt * PCMMax_f * (rand - 0.5_flt))};
-			if (channels_ == 2)
-				value *= stereo[channel];
-			accumulate(music_data_[position * channels_ + channel], value);
-		}
+	constexpr music_size Chunk {1 << 16};
+	const Darren::Random<float_type> noise {Rand.Split()};
+	ParallelFor((t_samples_ + Chunk - 1) / Chunk, HardwareThreads(), [&](size_t chunk) {
+		Darren::Random<float_type> stream {noise.Stream(chunk)};
+		const music_size start {chunk * Chunk}, end {std::min(start + Chunk, t_samples_)};
+		std::vector<float_type> values((end - start) * channels_);
+		stream.Fill(values, -amp * PCMMax_f, amp * PCMMax_f);
+		for (music_size position {start}; position < end; position++)
+			for (int channel {0}; channel < channels_; channel++) {
+				float_type value {values[(position - start) * channels_ + channel]};
+				if (channels_ == 2)
+					value *= stereo[channel];
+				accumulate(music_data_[position * channels_ + channel], value);
+			}
+	});
 }
 
-void Sound::RedNoise(float_type amp, Stereo stereo) {
+// One filter and substream per channel, so stereo channels are
+// decorrelated. amp sets four standard deviations, close to the peak.
+void Sound::ColouredNoise(noise_colour colour, float_type amp, Stereo stereo) {
 	AssertMusic();
-	Sound temp;
-	temp.CreateSilenceSamples(channels_, sample_rate_, t_samples_, p_samples_);
-	temp.WhiteNoise(0.1);
-	temp.Integrate(1000.0, 0.000001, 0.0);
-	temp.HighPass(25.0);
-	temp.Debias(debias_type::mean);
-	temp.Histogram(true, false, 0.0);
-	DoOverlay(temp).stereo(stereo * amp)();
+	constexpr music_size Chunk {1 << 16};
+	const Darren::Random<float_type> noise {Rand.Split()};
+	const float_type mean_stereo {0.5_flt * (stereo[0] + stereo[1])},
+		scale {amp * PCMMax_f / 4.0_flt}, unit {sqrt(3.0_flt)};
+	ParallelFor(channels_, HardwareThreads(), [&](size_t channel) {
+		Darren::Random<float_type> stream {noise.Stream(channel)};
+		NoiseFilter filter {colour, static_cast<float_type>(sample_rate_)};
+		const float_type channel_scale {scale * ((channels_ == 2) ? stereo[channel] : mean_stereo)};
+		std::vector<float_type> values(Chunk);
+		for (music_size start {0}; start < t_samples_; start += Chunk) {
+			const music_size length {std::min(Chunk, t_samples_ - start)};
+			stream.Fill(std::span(values).first(length), -unit, unit);
+			for (music_size index {0}; index < length; index++)
+				accumulate(music_data_[(start + index) * channels_ + channel], filter(values[index]) * channel_scale);
+		}
+	});
 }
 
 void Sound::VelvetNoise(float_type freq, float_type amp, Stereo stereo) {
@@ -918,16 +1158,41 @@ void Sound::VelvetNoise(float_type freq, float_type amp, Stereo stereo) {
 		}
 }
 
+inline Wavetable::Shape WaveShape(synth_type type) noexcept {
+	switch (type) {
+	case synth_type::power:
+		return SynthPower;
+	case synth_type::saw:
+		return [](float_type phi, float_type) {return SynthSaw(phi);};
+	case synth_type::triangle:
+		return [](float_type phi, float_type) {return SynthTriangle(phi);};
+	case synth_type::powertriangle:
+		return SynthPowerTriangle;
+	case synth_type::square:
+		return [](float_type phi, float_type) {return SynthSquare(phi);};
+	case synth_type::pulse:
+		return SynthPulse;
+	default:
+		return [](float_type phi, float_type) {return SinPhi(phi);};
+	}
+}
+
+// Fixed shapes read band-limited tables. A pulse whose width follows the
+// tremolo is corrected by PolyBLEP instead; the other modulated shapes have
+// no steps and stay as they are.
 void Sound::Waveform(const Wave wave, const Phaser phaser,
 		const Wave tremolo, float_type power, synth_type type, Stereo stereo) {
 	AssertMusic();
 	constexpr float_type BigPhi {1.0};
 	if (channels_ > 2)
 		throw EError("Wave synth only currently works with 1- or 2-channel sound.");
-	const float_type& freq {wave.freq()}, &amp {wave.amp()},
-		&offset {wave.offset()}, &phaser_freq {phaser.freq()},
-		&phaser_amp {phaser.amp()}, stereo_mean_amp {(stereo[0] + stereo[1]) / 2.0_flt};
-	float_type value {0}, wave_phi {offset}, phaser_phi {phaser.offset()},
+	const float_type& freq {wave.freq()}, &offset {wave.offset()}, &phaser_freq {phaser.freq()},
+		&phaser_amp {phaser.amp()}, amp {wave.amp() * PCMMax_f}, stereo_mean_amp {(stereo[0] + stereo[1]) / 2.0_flt};
+	const std::shared_ptr<const Wavetable> sine {Wavetable::Cached(static_cast<int>(synth_type::sine), 0.0, WaveShape(synth_type::sine))};
+	auto Sine = [&sine](float_type phi) {
+		return sine->Lookup(phi, 0);
+	};
+	float_type wave_phi {offset}, phaser_phi {phaser.offset()},
 			wave_velocity {freq / static_cast<float_type>(sample_rate_)},
 			phaser_velocity {phaser_freq / static_cast<float_type>(sample_rate_)},
 			bend_rate {pow(phaser.bend_factor(), 1.0_flt / static_cast<float_type>(Samples(1.0_flt)))},
@@ -935,53 +1200,133 @@ void Sound::Waveform(const Wave wave, const Phaser phaser,
 			tremolo_phi {tremolo.offset()},
 			tremolo_velocity {tremolo.freq() / static_cast<float_type>(sample_rate_)},
 			tremolo_amp {tremolo.amp()};
-	for (music_size position {0}; position < p_samples_; position++) {
-		phaser_phi += phaser_velocity;
-		bend *= bend_rate;
-		const float_type scaled_phaser_velocity {SinPhi(phaser_phi) * phaser_amp + 1.0_flt};
-		wave_phi += wave_velocity * scaled_phaser_velocity * bend;
-		//wave_phi += wave_velocity;
-		while (wave_phi > BigPhi)
-			wave_phi -= BigPhi;
-		tremolo_phi += tremolo_velocity;
-		if (tremolo_phi > BigPhi)
-			tremolo_phi -= BigPhi;
-		switch (type) {
-		case synth_type::constant:
-			value = amp * PCMMax_f;
-			break;
-		case synth_type::sine:
-			value = SinPhi(wave_phi) * amp * PCMMax_f;
-			break;
-		case synth_type::power:
-			value = SynthPower(wave_phi,
-					(SinPhi(tremolo_phi) * tremolo_amp + 1.0) * power) * amp * PCMMax_f;
-			break;
-		case synth_type::saw:
-			value = SynthSaw(wave_phi) * amp * PCMMax_f;
-			break;
-		case synth_type::triangle:
-			value = SynthTriangle(wave_phi) * amp * PCMMax_f;
-			break;
-		case synth_type::powertriangle:
-			value = SynthPowerTriangle(wave_phi,
-					(SinPhi(tremolo_phi) * tremolo_amp + 1.0) * power) * amp * PCMMax_f;
-			break;
-		case synth_type::square:
-			value = SynthSquare(wave_phi) * amp * PCMMax_f;
-			break;
-		case synth_type::pulse:
-			value = SynthPulse(wave_phi,
-					(SinPhi(tremolo_phi) * tremolo_amp + 1.0) * power) * amp * PCMMax_f;
-			break;
-		default:
-			break;
-		};
-		if (channels_ == 2) {
-			for (int channel {0}; channel < channels_; channel++)
-				accumulate(music_data_[position * channels_ + channel], value * stereo[channel]);
-		} else
-			accumulate(music_data_[position], value * stereo_mean_amp);
+	auto Render = [&](auto Value) {
+		for (music_size position {0}; position < p_samples_; position++) {
+			bend *= bend_rate;
+			float_type velocity {wave_velocity * bend};
+			if (phaser_amp != 0.0_flt) {
+				phaser_phi += phaser_velocity;
+				if (phaser_phi > BigPhi)
+					phaser_phi -= BigPhi;
+				velocity *= Sine(phaser_phi) * phaser_amp + 1.0_flt;
+			}
+			wave_phi += velocity;
+			while (wave_phi > BigPhi)
+				wave_phi -= BigPhi;
+			tremolo_phi += tremolo_velocity;
+			if (tremolo_phi > BigPhi)
+				tremolo_phi -= BigPhi;
+			const float_type value {Value(wave_phi, velocity) * amp};
+			if (channels_ == 2) {
+				for (int channel {0}; channel < channels_; channel++)
+					accumulate(music_data_[position * channels_ + channel], value * stereo[channel]);
+			} else
+				accumulate(music_data_[position], value * stereo_mean_amp);
+		}
+	};
+	const bool modulated {(tremolo_amp != 0.0_flt) && ((type == synth_type::power)
+		|| (type == synth_type::powertriangle) || (type == synth_type::pulse))};
+	auto Exponent = [&]() {
+		return (Sine(tremolo_phi) * tremolo_amp + 1.0_flt) * power;
+	};
+	if (type == synth_type::constant)
+		Render([](float_type, float_type) {return 1.0_flt;});
+	else if (!modulated) {
+		const std::shared_ptr<const Wavetable> table {Wavetable::Cached(static_cast<int>(type),
+			(type == synth_type::power) || (type == synth_type::powertriangle) || (type == synth_type::pulse) ? power : 0.0_flt,
+			WaveShape(type))};
+		float_type last_velocity {-1.0};
+		size_t level {0};
+		Render([&table, &last_velocity, &level](float_type phi, float_type velocity) {
+			if (velocity != last_velocity) {
+				last_velocity = velocity;
+				level = Wavetable::Level(velocity);
+			}
+			return table->Lookup(phi, level);
+		});
+	} else if (type == synth_type::pulse)
+		Render([&Exponent](float_type phi, float_type velocity) {
+			const float_type width {Exponent() / 2.0_flt}, step {std::abs(velocity)};
+			float_type value {SynthPulse(phi, width * 2.0_flt)};
+			if ((width > 0.0_flt) && (width < 1.0_flt) && (step < 0.5_flt)) {
+				const float_type mod_phi {ModPhi(phi - 0.25_flt)};
+				value += PolyBLEP(ModPhi(mod_phi - width), step) - PolyBLEP(mod_phi, step);
+			}
+			return value;
+		});
+	else {
+		const Wavetable::Shape shape {WaveShape(type)};
+		Render([&Exponent, shape](float_type phi, float_type) {
+			return shape(phi, Exponent());
+		});
+	}
+}
+
+// Every partial in one pass: each is a complex phasor rotated once per
+// sample, in lanes the compiler can vectorise, and set again from the exact
+// phase at the start of each block so rounding cannot build up. Partials at
+// or above Nyquist are dropped.
+void Sound::Sines(float_type fundamental, const std::vector<float_type>& amps, Stereo stereo) {
+	AssertMusic();
+	if (channels_ > 2)
+		throw EError("Sines synth only currently works with 1- or 2-channel sound.");
+	constexpr size_t Lanes {8}, Block {256};
+	const double fundamental_velocity {static_cast<double>(fundamental) / static_cast<double>(sample_rate_)};
+	std::vector<double> velocities;
+	std::vector<float_type> partial_amps;
+	for (size_t harmonic {1}; harmonic <= amps.size(); harmonic++)
+		if (const double velocity {fundamental_velocity * static_cast<double>(harmonic)};
+				(velocity < 0.5) && (amps[harmonic - 1] != 0.0_flt)) {
+			velocities.push_back(velocity);
+			partial_amps.push_back(amps[harmonic - 1] * PCMMax_f);
+		}
+	if (velocities.empty())
+		return;
+	const size_t count {(velocities.size() + Lanes - 1) / Lanes * Lanes};
+	velocities.resize(count, 0.0);
+	partial_amps.resize(count, 0.0_flt);
+	struct Group {
+		std::array<float_type, Lanes> real, imag, rotate_real, rotate_imag;
+	};
+	std::vector<Group> groups(count / Lanes);
+	for (size_t partial {0}; partial < count; partial++) {
+		Group& group {groups[partial / Lanes]};
+		group.rotate_real[partial % Lanes] = static_cast<float_type>(std::cos(2.0 * std::numbers::pi * velocities[partial]));
+		group.rotate_imag[partial % Lanes] = static_cast<float_type>(std::sin(2.0 * std::numbers::pi * velocities[partial]));
+	}
+	const float_type stereo_mean_amp {(stereo[0] + stereo[1]) / 2.0_flt};
+	std::array<float_type, Block> block;
+	for (music_size start {0}; start < p_samples_; start += Block) {
+		const size_t length {std::min(static_cast<size_t>(Block), static_cast<size_t>(p_samples_ - start))};
+		for (size_t partial {0}; partial < count; partial++) {
+			Group& group {groups[partial / Lanes]};
+			double phase {velocities[partial] * static_cast<double>(start + 1)};
+			phase = 2.0 * std::numbers::pi * (phase - std::floor(phase));
+			group.real[partial % Lanes] = partial_amps[partial] * static_cast<float_type>(std::cos(phase));
+			group.imag[partial % Lanes] = partial_amps[partial] * static_cast<float_type>(std::sin(phase));
+		}
+		for (size_t index {0}; index < length; index++) {
+			std::array<float_type, Lanes> sum {};
+			for (Group& group : groups)
+				for (size_t lane {0}; lane < Lanes; lane++) {
+					const float_type real {group.real[lane]}, imag {group.imag[lane]};
+					sum[lane] += imag;
+					group.real[lane] = real * group.rotate_real[lane] - imag * group.rotate_imag[lane];
+					group.imag[lane] = real * group.rotate_imag[lane] + imag * group.rotate_real[lane];
+				}
+			float_type total {0.0};
+			for (const float_type lane_sum : sum)
+				total += lane_sum;
+			block[index] = total;
+		}
+		for (size_t index {0}; index < length; index++) {
+			const music_size position {start + index};
+			if (channels_ == 2) {
+				for (int channel {0}; channel < channels_; channel++)
+					accumulate(music_data_[position * channels_ + channel], block[index] * stereo[channel]);
+			} else
+				accumulate(music_data_[position], block[index] * stereo_mean_amp);
+		}
 	}
 }
 
@@ -1167,7 +1512,16 @@ void Sound::WindowedFilterLayer(Filter filter, Envelope env, Sound& output, Wind
 	output.WindowedOverlay(temp, window);
 }
 
-void Sound::WindowedFilter(Filter start_filter, Filter end_filter, int window_count) {
+inline float_type curve_at(const std::vector<float_type>& curve, float_type position) noexcept {
+	if (curve.size() < 2)
+		return curve.empty() ? position : curve.front();
+	const float_type scaled {std::clamp(position, 0.0_flt, 1.0_flt) * static_cast<float_type>(curve.size() - 1)};
+	const size_t index {std::min(static_cast<size_t>(scaled), curve.size() - 2)};
+	const float_type fraction {scaled - static_cast<float_type>(index)};
+	return curve[index] * (1.0_flt - fraction) + curve[index + 1] * fraction;
+}
+
+void Sound::WindowedFilter(Filter start_filter, Filter end_filter, int window_count, const std::vector<float_type>& curve) {
 	AssertMusic();
 	if (start_filter.type() != end_filter.type())
 		throw EError("Can only blend filters which are the same type.");
@@ -1175,32 +1529,52 @@ void Sound::WindowedFilter(Filter start_filter, Filter end_filter, int window_co
 	output.Amp(0.0);
 	const float_type sample_length {get_pSeconds()},
 		window_length {sample_length / static_cast<float_type>(window_count)};
+	auto Blend = [&](float_type position) {
+		return Filter::BalanceFilters(start_filter, end_filter, curve_at(curve, position));
+	};
 	Envelope env {Envelope::TriangularWindow(0.0, 0.0, window_length)};
-	WindowedFilterLayer(start_filter, env, output, Window(0.0, window_length));
+	WindowedFilterLayer(curve.empty() ? start_filter : Blend(0.0), env, output, Window(0.0, window_length));
 	for (int index {1}; index < window_count; index++) {
 		const float_type window_peak {window_length * static_cast<float_type>(index)};
 		env = Envelope::TriangularWindow(window_peak - window_length, window_peak,
 			window_peak + window_length);
-		Filter filter {Filter::BalanceFilters(start_filter, end_filter,
-			static_cast<float_type>(index) / static_cast<float_type>(window_count))};
-		WindowedFilterLayer(filter, env, output, Window(window_peak - window_length, window_peak + window_length));
+		WindowedFilterLayer(Blend(static_cast<float_type>(index) / static_cast<float_type>(window_count)),
+			env, output, Window(window_peak - window_length, window_peak + window_length));
 	}
 	env = Envelope::TriangularWindow(sample_length - window_length, sample_length, sample_length);
-	WindowedFilterLayer(end_filter, env, output, Window(sample_length - window_length, sample_length));
+	WindowedFilterLayer(curve.empty() ? end_filter : Blend(1.0), env, output, Window(sample_length - window_length, sample_length));
 	*this = output;
 }
 
+void Sound::FilterSweep(Filter start_filter, Filter end_filter, const std::vector<float_type>& curve, int window_count) {
+	AssertMusic();
+	if (start_filter.type() != end_filter.type())
+		throw EError("Can only blend filters which are the same type.");
+	if ((start_filter.order() != end_filter.order())
+			|| (start_filter.GetFlag(filter_direction::linkwitz_riley) != end_filter.GetFlag(filter_direction::linkwitz_riley)))
+		throw EError("Can only blend filters with the same order and Linkwitz-Riley setting.");
+	if (!start_filter.isBiquad()) {
+		WindowedFilter(start_filter, end_filter, window_count, curve);
+		return;
+	}
+	const float_type length {static_cast<float_type>(p_samples_)};
+	const bool wrap {start_filter.GetFlag(filter_direction::wrap) || end_filter.GetFlag(filter_direction::wrap)};
+	BiquadCascade::Sweep(music_data_, channels_, p_samples_, [&](size_t frame) {
+		return Filter::BalanceFilters(start_filter, end_filter,
+			curve_at(curve, static_cast<float_type>(frame) / length)).Cascade(sample_rate_);
+	}, wrap);
+}
+
 void Sound::ApplyFilter(Filter filter) {
 	AssertMusic();
 	const music_size length {p_samples_};
-	if (filter.flags()[filter_direction::wrap])
+	// IIR filters wrap by priming on the tail and Fourier filters by transforming at the exact length.
+	const bool wrap {filter.GetFlag(filter_direction::wrap)},
+		tile {wrap && (filter.type() == filter_type::pitch_scale)};
+	if (tile)
 		Repeat(3);
-	if (filter.type() == filter_type::lo)
-		LowPass(filter.omega());
-	else if (filter.type() == filter_type::hi)
-		HighPass(filter.omega());
-	else if (filter.type() == filter_type::band)
-		BandPass(filter.frequency(), filter.bandwidth(), filter.gain());
+	if (filter.isBiquad())
+		ApplyCascade(filter.Cascade(sample_rate_), wrap);
 	else if (filter.type() == filter_type::amp)
 		Amp(filter.gain());
 	else if (filter.type() == filter_type::distort)
@@ -1214,117 +1588,56 @@ void Sound::ApplyFilter(Filter filter) {
 	} else if (filter.type() == filter_type::narrow_stereo) {
 		CrossFade(CrossFader::AmpCross(Stereo(1.0 - 0.5 * filter.gain()), Stereo(0.5 * filter.gain())));
 	} else if (filter.type() == filter_type::fourier_gain) {
-		FourierGain(filter.low_gain(),filter.low_shoulder(),filter.high_shoulder(),filter.high_gain());
+		FourierGain(filter.low_gain(),filter.low_shoulder(),filter.high_shoulder(),filter.high_gain(), wrap);
 	} else if (filter.type() == filter_type::fourier_bandpass) {
-		FourierBandpass(filter.frequency(), filter.bandwidth(), filter.gain(), filter.GetFlag(filter_direction::comb));
+		FourierBandpass(filter.frequency(), filter.bandwidth(), filter.gain(), filter.GetFlag(filter_direction::comb), wrap);
 	} else if (filter.type() == filter_type::fourier_clean) {
-		FourierClean(filter.gain(), false, false);
+		FourierClean(filter.gain(), false, false, wrap);
 	} else if (filter.type() == filter_type::fourier_cleanpass) {
-		FourierClean(filter.gain(), true, false);
+		FourierClean(filter.gain(), true, false, wrap);
 	} else if (filter.type() == filter_type::fourier_limit) {
-		FourierClean(filter.gain(), false, true);
+		FourierClean(filter.gain(), false, true, wrap);
 	} else if (filter.type() == filter_type::pitch_scale) {
 		PitchScale(filter.gain());
 	} else if (filter.type() == filter_type::inverse_lr) {
 		CrossFade(CrossFader::AmpInverseLR());
 	}
-	if (filter.flags()[filter_direction::wrap]) {
+	if (tile) {
 		Cut(0, length);
 		Cut(length, length * 2);
 	}
 }
 
-void Sound::LowPass(float_type rRC) {
-	AssertMusic();
-	const float_type RC {1.0_flt / rRC}, dt {1.0_flt / static_cast<float_type>(sample_rate_)},
-		a {dt / (dt + RC)};
-	std::array<float_type, 2> previous = { 0, 0 };
-	for (music_size position {0}; position < p_samples_; position++)
-		for (int channel {0}; channel < channels_; channel++) {
-			music_type& sample {music_data_[position * channels_ + channel]};
-			const float_type value {a * static_cast<float_type>(sample)
-				+ (1.0_flt - a) * previous[channel]};
-			sample = value;
-			previous[channel] = value;
-		}
+void Sound::ApplyFilters(const FilterVector& filters) {
+	FilterChain(filters, sample_rate_).Apply(*this);
 }
 
-void Sound::HighPass(float_type rRC) {
-	AssertMusic();
-	const float_type RC {1.0_flt / rRC}, dt {1.0_flt / static_cast<float_type>(sample_rate_)},
-			a {RC / (dt + RC)};
-	std::array<float_type, 2> previous_value { { 0, 0 } };
-	std::array<music_type, 2> previous_sample { { 0, 0 } };
-	for (music_size position {0}; position < p_samples_; position++)
-		for (int channel {0}; channel < channels_; channel++) {
-			music_type& sample {music_data_[position * channels_ + channel]};
-			const float_type value {a * static_cast<float_type>(sample - previous_sample[channel])
-				+ a * previous_value[channel]};
-			previous_sample[channel] = sample;
-			sample = value;
-			previous_value[channel] = value;
-		}
-}
-
-void Sound::BandPass(float_type frequency, float_type bandwidth, float_type gain) {
-	AssertMusic();
-	const float_type A {pow(10.0_flt, gain / 40.0_flt)},
-		w0 {physics::TwoPi * frequency / static_cast<float_type>(sample_rate_)},
-		c {cos(w0)}, s {sin(w0)},
-		alpha {s * sinh(log(2.0_flt) / 2.0_flt * bandwidth * w0 / s)};
-	float_type b0 {1.0_flt + alpha * A}, b1 {-2.0_flt * c}, b2 {1.0_flt - alpha * A},
-		a0 {1.0_flt + alpha / A}, a1 {-2.0_flt * c}, a2 {1.0_flt - alpha / A};
-	b0 /= a0;
-	b1 /= a0;
-	b2 /= a0;
-	a1 /= a0;
-	a2 /= a0;
-	for (int channel {0}; channel < channels_; channel++) {
-		float_type xmem1 {0.0}, xmem2 {0.0}, ymem1 {0.0}, ymem2 {0.0};
-		for (music_size position {0}; position < p_samples_; position++) {
-			music_type& sample {music_data_[position * channels_ + channel]};
-			const float_type x {static_cast<float_type>(sample) / PCMMax_f};
-			const float_type y {b0 * x + b1 * xmem1 + b2 * xmem2 - a1 * ymem1 - a2 * ymem2};
-			xmem2 = xmem1;
-			xmem1 = x;
-			ymem2 = ymem1;
-			ymem1 = y;
-			if (const int s {static_cast<int>(y * PCMMax_f)}; s > PCMMax)
-				sample = PCMMax;
-			else if (s < PCMMin)
-				sample = PCMMin;
-			else
-				sample = s;
-		}
-	}
-}
-
-void Sound::FourierSplit(std::function<void (Fourier&)> Lambda) {
+void Sound::FourierSplit(std::function<void (Fourier&)> Lambda, bool exact) {
 	AssertMusic();
 	if (channels_ == 2) {
-		Sound left, right;
-		Split(left, right);
-		left.FourierSplit(Lambda);
-		right.FourierSplit(Lambda);
-		Combine(left, right);
+		Fourier left, right;
+		Fourier::TransformPair(music_data_, p_samples_, left, right, exact);
+		Lambda(left);
+		Lambda(right);
+		Fourier::InverseTransformPair(left, right, music_data_);
 	} else if (channels_ == 1) {
-		Fourier spectrum {music_data_};
+		Fourier spectrum {music_data_, exact};
 		Lambda(spectrum);
 		spectrum.InverseTransform(music_data_);
 	} else throw EError("Fourier filters only work on 1-2 channels.");
 }
 
 void Sound::FourierGain(float_type low_gain, float_type low_shoulder,
-		float_type high_shoulder, float_type high_gain) {
+		float_type high_shoulder, float_type high_gain, bool wrap) {
 	FourierSplit([this, low_gain, low_shoulder, high_shoulder, high_gain] (Fourier& fourier) {
 		fourier.GainFilter(low_gain, low_shoulder, high_shoulder, high_gain, sample_rate_);
-	});
+	}, wrap);
 }
 
-void Sound::FourierBandpass(float_type frequency, float_type bandwidth, float_type filter_gain, bool comb) {
+void Sound::FourierBandpass(float_type frequency, float_type bandwidth, float_type filter_gain, bool comb, bool wrap) {
 	FourierSplit([this, frequency, bandwidth, filter_gain, comb] (Fourier& fourier) {
 		fourier.BandpassFilter(frequency, bandwidth, filter_gain, comb, sample_rate_);
-	});
+	}, wrap);
 }
 
 void Sound::FourierShift(float_type frequency) {
@@ -1333,10 +1646,10 @@ void Sound::FourierShift(float_type frequency) {
 	});
 }
 
-void Sound::FourierClean(float_type min_gain, bool pass, bool limit) {
+void Sound::FourierClean(float_type min_gain, bool pass, bool limit, bool wrap) {
 	FourierSplit([this, min_gain, pass, limit] (Fourier& fourier) {
 		fourier.Clean(min_gain, 1, pass, limit);
-	});
+	}, wrap);
 }
 
 void Sound::FourierScale(float_type factor) {
@@ -1351,52 +1664,57 @@ void Sound::FourierPower(float_type power) {
 	});
 }
 
-void Sound::PitchScale(float_type factor) {
+// Analyses the channels mixed to mono; `file_name` may be empty.
+SpectralSummary Sound::Spectrogram(size_t frame, size_t hop, const std::string& file_name, bool binary, bool plot, size_t threads) const {
 	AssertMusic();
-	if (channels_ == 2) {
-		Sound left, right;
-		Split(left, right);
-		left.PitchScale(factor);
-		right.PitchScale(factor);
-		Combine(left, right);
-	} else if (channels_ == 1) {
-		MonoPitchScale(factor);
-	} else throw EError("Pitch scale only works on 1-2 channels..");
-}
-
-inline float_type window_func(float_type x) noexcept {
-	constexpr float_type halfpi {1.570796327};
-	//if (x > 1.0) x = 2.0 - x;
-	//return x;
-	x = sin(x*halfpi);
-	return x*x;
-}
-
-void Sound::MonoPitchScale(float_type factor) {
-	const float_type min_f {40.0_flt / factor};
-	const music_size window_size {1u << static_cast<int>(floor(log2(static_cast<float_type>(sample_rate_) / min_f) + 1.0))};
-	const music_size src_length {(p_samples_/window_size + 2) * window_size},
-		num_windows {src_length / window_size};
-	//std::println("{} {} {} {} samples", window_size, p_samples_, src_length, num_windows);
-	MusicVector src(src_length, 0),
-		dest(src_length, 0);
-	std::copy(music_data_.begin(), music_data_.end(), src.begin() + window_size);
-	for (music_size index {0}; index < num_windows - 1; index ++) {
-		//std::println("{} {} index", index, num_windows);
-		MusicVector window(src.begin() + index * window_size, src.begin() + (index + 2) * window_size);
-		for (music_size i {0}; i < window_size * 2; i++) {
-			float_type frac = {window_func(static_cast<float_type>(i)/static_cast<float_type>(window_size))};
-			window[i] *= frac;
-		}
-		Fourier spectrum {window};
-		spectrum.Scale(1.0/factor);
-		spectrum.InverseTransform(window);
-		for (music_size i {0}; i < window_size * 2; i++) {
-			//float_type frac = window_func(static_cast<float_type>(i)/static_cast<float_type>(window_size));
-			dest[index * window_size + i] += window[i]; // * frac;
-		}
+	const SpectrumAnalyser analyser {frame ? frame : SpectrumAnalyser::DefaultFrame(sample_rate_), hop, threads};
+	const size_t frames {analyser.Frames(p_samples_)};
+	std::ofstream file;
+	if (!file_name.empty()) {
+		file.open(file_name, binary ? std::ios::out | std::ios::binary : std::ios::out);
+		if (!file.is_open())
+			throw EError("Saving spectrogram: Open failed.");
+		analyser.WriteHeader(file, binary, frames, sample_rate_);
 	}
-	std::copy(dest.begin() + window_size, dest.begin() + window_size + p_samples_, music_data_.begin());
+	SpectralSummary summary {analyser, sample_rate_, frames, plot};
+	analyser.Process(music_data_, channels_, p_samples_, [&](size_t index, const SpectrumAnalyser::Samples& magnitudes) {
+		summary.Add(index, magnitudes);
+		if (file.is_open())
+			analyser.WriteFrame(file, binary, index, magnitudes, sample_rate_);
+	});
+	if (file.is_open() && !file)
+		throw EError("Saving spectrogram: Write failed.");
+	return summary;
+}
+
+void Sound::PitchScale(float_type factor, size_t frame, size_t overlap, size_t threads) {
+	Vocode(1.0, 1.0 / factor, frame, overlap, threads);
+}
+
+void Sound::TimeStretch(float_type factor, size_t frame, size_t overlap, size_t threads) {
+	Vocode(factor, 1.0, frame, overlap, threads);
+}
+
+void Sound::Vocode(float_type stretch, float_type pitch, size_t frame, size_t overlap, size_t threads) {
+	AssertMusic();
+	const PhaseVocoder vocoder {frame ? frame : PhaseVocoder::DefaultFrame(sample_rate_), overlap ? overlap : 4, threads};
+	const music_size length {static_cast<music_size>(std::lround(static_cast<float_type>(p_samples_) * stretch))};
+	std::vector<PhaseVocoder::Samples> outputs;
+	PhaseVocoder::Samples input(p_samples_);
+	for (int channel {0}; channel < channels_; channel++) {
+		for (music_size position {0}; position < p_samples_; position++)
+			input[position] = static_cast<float_type>(music_data_[position * channels_ + channel]) / PCMMax_f;
+		outputs.push_back(vocoder.Process(input, length, stretch, pitch));
+	}
+	if (length != p_samples_) {
+		const music_size loop_start {static_cast<music_size>(static_cast<float_type>(loop_start_samples_) * stretch)};
+		Resize(static_cast<music_size>(static_cast<float_type>(t_samples_) * stretch), length, false);
+		loop_start_samples_ = std::min(loop_start, length ? length - 1 : 0);
+	}
+	for (int channel {0}; channel < channels_; channel++)
+		for (music_size position {0}; position < p_samples_; position++)
+			music_data_[position * channels_ + channel] = static_cast<music_type>(std::clamp(
+				outputs[channel][position] * PCMMax_f, static_cast<float_type>(PCMMin), PCMMax_f));
 }
 
 void Sound::Integrate(float_type factor, float_type leak_per_second, float_type constant) {
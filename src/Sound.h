@@ -13,10 +13,12 @@
 #ifndef SEQUENCE_H_
 #define SEQUENCE_H_
 
+#include <algorithm>
 #include <cmath>
 #include <string>
 #include <bitset>
 #include <vector>
+#include <functional>
 
 #include "Envelope.h"
 #include "Waveform.h"
@@ -24,6 +26,10 @@
 #include "Random.h"
 #include "Stereo.h"
 #include "Fourier.h"
+#include "Image.h"
+#include "Biquad.h"
+#include "Spectrogram.h"
+#include "Noise.h"
 
 namespace BoxyLady {
 
@@ -40,7 +46,7 @@ enum class synth_type {
 	sine, power, saw, square, triangle, pulse, powertriangle, constant
 };
 enum class filter_type {
-	none, hi, lo, band, amp, distort, ks_blend, ks_reverse,
+	none, hi, lo, band, lo_shelf, hi_shelf, notch, butter_lo, butter_hi, amp, distort, ks_blend, ks_reverse,
 	fourier_gain, fourier_bandpass, fourier_clean, fourier_cleanpass, fourier_limit,
 	narrow_stereo, pitch_scale, inverse_lr
 };
@@ -48,13 +54,14 @@ enum class overlay {
 	loop, random, slur_on, slur_off, envelope_compress, resize, trim, gate, n
 };
 enum class filter_direction {
-	wrap, offset, comb, n
+	wrap, offset, comb, linkwitz_riley, n
 };
 
 using FilterFlags = Flags<filter_direction>;
 using OverlayFlags = Flags<overlay>;
 
 class Sound;
+class FilterChain;
 class MetadataList;
 class MetadataPoint;
 
@@ -78,6 +85,8 @@ public:
 	std::string Mp3CommandUpdate(std::string) const;
 	void WriteWavInfo(std::ofstream&) const;
 	void EditListItem(std::string, std::string, std::string, std::string = "");
+	void WriteImage(ImageWriter&) const;
+	void ReadImage(ImageReader&);
 };
 
 class Window {
@@ -113,6 +122,7 @@ private:
 	filter_type type_;
 	float_type frequency_, bandwidth_, gain_, omega_;
 	float_type low_gain_, low_shoulder_, high_shoulder_, high_gain_;
+	int order_;
 	FilterFlags flags_;
 	Filter& SetGain(float_type gain_val) noexcept {
 		gain_ = gain_val;
@@ -140,7 +150,7 @@ private:
 	explicit Filter(filter_type type_val) noexcept :
 		type_{type_val}, frequency_{0.0}, bandwidth_{0.0}, gain_{0.0}, omega_{0.0},
 		low_gain_{0.0}, low_shoulder_{0.0}, high_shoulder_{0.0}, high_gain_{0.0},
-		flags_{0} {}
+		order_{0}, flags_{0} {}
 public:
 	FilterFlags flags() const {return flags_;}
 	filter_type type() const noexcept {return type_;}
@@ -152,6 +162,18 @@ public:
 	float_type high_gain() const noexcept {return high_gain_;}
 	float_type low_shoulder() const noexcept {return low_shoulder_;}
 	float_type high_shoulder() const noexcept {return high_shoulder_;}
+	int order() const noexcept {return order_;}
+	bool isBiquad() const noexcept {
+		return (type_ == filter_type::lo) || (type_ == filter_type::hi) || (type_ == filter_type::band)
+			|| (type_ == filter_type::lo_shelf) || (type_ == filter_type::hi_shelf) || (type_ == filter_type::notch)
+			|| (type_ == filter_type::butter_lo) || (type_ == filter_type::butter_hi);
+	}
+	bool isFourier() const noexcept {
+		return (type_ == filter_type::fourier_gain) || (type_ == filter_type::fourier_bandpass)
+			|| (type_ == filter_type::fourier_clean) || (type_ == filter_type::fourier_cleanpass)
+			|| (type_ == filter_type::fourier_limit);
+	}
+	BiquadCascade Cascade(music_size) const;
 	Filter& SetFlag(filter_direction flag, bool value) {
 		flags_[flag] = value;
 		return *this;
@@ -168,6 +190,21 @@ public:
 	static Filter BandPass(float_type frequency_val, float_type bandwith_val, float_type gain_val, bool wrap) {
 		return Filter(filter_type::band).SetBandPass(frequency_val, bandwith_val, gain_val, wrap);
 	}
+	static Filter LowShelf(float_type frequency_val, float_type slope_val, float_type gain_val, bool wrap) {
+		return Filter(filter_type::lo_shelf).SetBandPass(frequency_val, slope_val, gain_val, wrap);
+	}
+	static Filter HighShelf(float_type frequency_val, float_type slope_val, float_type gain_val, bool wrap) {
+		return Filter(filter_type::hi_shelf).SetBandPass(frequency_val, slope_val, gain_val, wrap);
+	}
+	static Filter Notch(float_type frequency_val, float_type bandwith_val, bool wrap) {
+		return Filter(filter_type::notch).SetBandPass(frequency_val, bandwith_val, 0.0, wrap);
+	}
+	static Filter Butterworth(float_type frequency_val, int order_val, bool high, bool linkwitz_riley, bool wrap) {
+		Filter filter {Filter(high ? filter_type::butter_hi : filter_type::butter_lo)
+			.SetBandPass(frequency_val, 0.0, 0.0, wrap).SetFlag(filter_direction::linkwitz_riley, linkwitz_riley)};
+		filter.order_ = order_val;
+		return filter;
+	}
 	static Filter FourierGain(float_type low_gain, float_type low_shoulder, float_type high_shoulder, float_type high_gain) noexcept {
 		return Filter(filter_type::fourier_gain).SetShoulders(low_gain, low_shoulder, high_shoulder, high_gain);
 	}
@@ -209,6 +246,7 @@ public:
 using FilterVector = std::vector<Filter>;
 
 class Sound {
+	friend class FilterChain;
 private:
 	MusicVector music_data_;
 	music_size envelope_position_, scratcher_position_;
@@ -217,6 +255,8 @@ private:
 	music_size sample_rate_, t_samples_, p_samples_, m_samples_, loop_start_samples_;
 	bool loop_, start_anywhere_;
 	MetadataList metadata_;
+	std::optional<ImagePage> page_;
+	void LoadPage();
 	std::pair<music_pos, music_pos> WindowPair(Window) const noexcept;
 	void WindowFrame(music_pos&, music_pos&) const noexcept;
 	music_size Samples(float_type time) const noexcept {
@@ -335,6 +375,27 @@ public:
 		std::fill(music_data_.begin(), music_data_.end(), 0);
 	}
 	void SaveToFile(std::string, file_format, bool) const;
+	void WriteImageHeader(ImageWriter&, const ImagePage&) const;
+	ImagePage WriteImageSamples(ImageWriter& image) const {
+		return page_ ? image.CopySamples(*page_) : image.WriteSamples(music_data_);
+	}
+	void ReadImage(ImageReader&);
+	bool isResident() const noexcept {
+		return !page_;
+	}
+	bool isPagedFrom(const std::string& file_name) const {
+		return page_ && page_->isIn(file_name);
+	}
+	void PageIn() {
+		if (page_) LoadPage();
+	}
+	void PageOut();
+	size_t ResidentBytes() const noexcept {
+		return music_data_.capacity() * sizeof(music_type);
+	}
+	size_t SlackBytes() const noexcept {
+		return ResidentBytes() - std::min(ResidentBytes(), channels_ * p_samples_ * sizeof(music_type));
+	}
 	void CopyType(const Sound&) noexcept;
 	void Combine(const Sound&, const Sound&);
 	void Mix(const Sound&, const Sound&, Stereo, Stereo, int);
@@ -348,6 +409,7 @@ public:
 	void Cut(Window);
 	void Defrag() {
 		Resize(t_samples_, p_samples_, false);
+		music_data_.shrink_to_fit();
 	}
 	void Amp(float_type amp) {
 		CrossFade(CrossFader::Amp(amp));
@@ -356,10 +418,13 @@ public:
 	void DelayAmp(Stereo, Stereo, float_type);
 	void Reverse();
 	void EchoEffect(float_type, float_type, int, FilterVector, bool);
+	void FeedbackEcho(float_type, float_type, int, const FilterVector&, bool, bool);
+	void Convolve(const Sound&, float_type, float_type, bool, size_t, size_t, bool);
 	void Waveform(const Wave, const Phaser, const Wave, float_type, synth_type, Stereo = Stereo());
+	void Sines(float_type, const std::vector<float_type>&, Stereo = Stereo());
 	void OffsetSeconds(float_type, float_type, bool);
 	void WhiteNoise(float_type, Stereo = Stereo());
-	void RedNoise(float_type, Stereo = Stereo());
+	void ColouredNoise(noise_colour, float_type, Stereo = Stereo());
 	void VelvetNoise(float_type, float_type, Stereo = Stereo());
 	void CrackleNoise(float_type, Stereo = Stereo());
 	void Smatter(Sound&, float_type, float_type, float_type, bool, float_type, float_type, bool,
@@ -373,29 +438,33 @@ public:
 	void Flange(float_type, float_type);
 	void BitCrusher(int);
 	void ApplyFilter(Filter);
-	void ApplyFilters(FilterVector filters) {
-		for (auto filter : filters) ApplyFilter(filter);
-	}
+	void ApplyFilters(const FilterVector&);
 	void WindowedFilterLayer(Filter, Envelope, Sound&, Window);
-	void WindowedFilter(Filter, Filter, int);
-	void LowPass(float_type);
-	void HighPass(float_type);
-	void BandPass(float_type, float_type, float_type);
-	void FourierSplit(std::function<void (Fourier&)>);
-	void FourierGain(float_type, float_type, float_type, float_type);
-	void FourierBandpass(float_type, float_type, float_type, bool);
+	void WindowedFilter(Filter, Filter, int, const std::vector<float_type>&);
+	void FilterSweep(Filter, Filter, const std::vector<float_type>&, int);
+	void ApplyCascade(const BiquadCascade& cascade, bool circular = false) {
+		AssertMusic();
+		cascade.Process(music_data_, channels_, p_samples_, circular);
+	}
+	void FourierSplit(std::function<void (Fourier&)>, bool = false);
+	void FourierGain(float_type, float_type, float_type, float_type, bool = false);
+	void FourierBandpass(float_type, float_type, float_type, bool, bool = false);
 	void FourierShift(float_type);
-	void FourierClean(float_type, bool, bool);
+	void FourierClean(float_type, bool, bool, bool = false);
 	void FourierScale(float_type);
-	void PitchScale(float_type);
-	void MonoPitchScale(float_type);
+	void PitchScale(float_type, size_t = 0, size_t = 0, size_t = 0);
+	void TimeStretch(float_type, size_t = 0, size_t = 0, size_t = 0);
+	void Vocode(float_type, float_type, size_t, size_t, size_t);
 	void FourierPower(float_type);
+	SpectralSummary Spectrogram(size_t, size_t, const std::string&, bool, bool, size_t = 0) const;
 	void Integrate(float_type, float_type, float_type);
 	void Clip(float_type, float_type);
 	void Abs(float_type = 1.0);
 	void Fold(float_type);
 	void Octave(float_type);
 	void Repeat(int, FilterVector = FilterVector());
+	void KarplusStrong(const Sound&, float_type, float_type, float_type, float_type, float_type, float_type,
+		const FilterVector&, const FilterVector&);
 	void CorrelPlot() const;
 	void Plot() const;
 	void Histogram(bool, bool, float_type);
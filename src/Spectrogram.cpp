@@ -0,0 +1,234 @@
+//============================================================================
+// Name        : BoxyLady
+// Author      : Darren Green
+// Copyright   : (C) Darren Green 2011-2025
+// Description : Music sequencer
+//
+// License GPLv3+: GNU GPL version 3 or later <http://gnu.org/licenses/gpl.html>
+// This is free software; you are free to change and redistribute it.
+// There is NO WARRANTY, to the extent permitted by law.
+// Contact: darren.green@stir.ac.uk http://pinkmongoose.co.uk
+//============================================================================
+
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <format>
+#include <functional>
+#include <iterator>
+
+#include "Spectrogram.h"
+#include "Sound.h"
+#include "Parallel.h"
+
+namespace BoxyLady {
+
+SpectrumAnalyser::SpectrumAnalyser(size_t frame, size_t hop, size_t threads) :
+		frame_{frame}, hop_{hop ? hop : frame / 4}, threads_{threads ? threads : HardwareThreads()} {
+	if ((frame_ < 16) || (frame_ % 2))
+		throw EError("Spectrogram frame size must be even and at least 16.");
+	if (hop_ > frame_)
+		throw EError("Spectrogram hop must not exceed the frame size.");
+}
+
+size_t SpectrumAnalyser::DefaultFrame(size_t sample_rate) noexcept {
+	return std::bit_floor(std::max<size_t>(sample_rate / 20, 256));
+}
+
+size_t SpectrumAnalyser::Frames(size_t length) const noexcept {
+	if (length <= frame_)
+		return length ? 1 : 0;
+	return (length - frame_ + hop_ - 1) / hop_ + 1;
+}
+
+float_type SpectrumAnalyser::NoiseBandwidth() const {
+	float_type sum {0.0}, square_sum {0.0};
+	const auto window {Fourier::Window(frame_ / 2)};
+	for (const float_type value : *window) {
+		sum += value;
+		square_sum += value * value;
+	}
+	return static_cast<float_type>(frame_) * square_sum / (sum * sum);
+}
+
+// Two real frames share each complex FFT, as the real and imaginary parts.
+void SpectrumAnalyser::Process(const MusicVector& music_data, int channels, size_t length, const Sink& sink) const {
+	const size_t frames {Frames(length)}, bins {this->bins()}, batch_size {std::min(Batch, frames)};
+	const auto window_pointer {Fourier::Window(frame_ / 2)};
+	const Fourier::Curve& window {*window_pointer};
+	float_type window_sum {0.0};
+	for (const float_type value : window)
+		window_sum += value;
+	const float_type full_scale {static_cast<float_type>(channels) * PCMMax_f};
+	auto Sample = [&music_data, channels, length, full_scale](size_t index) {
+		if (index >= length)
+			return 0.0_flt;
+		float_type sum {0.0};
+		for (int channel {0}; channel < channels; channel++)
+			sum += static_cast<float_type>(music_data[index * channels + channel]);
+		return sum / full_scale;
+	};
+	std::vector<Samples> magnitudes(batch_size, Samples(bins));
+	std::vector<Fourier::ComplexVector> buffers((batch_size + 1) / 2, Fourier::ComplexVector(frame_));
+	for (size_t first {0}; first < frames; first += Batch) {
+		const size_t count {std::min(Batch, frames - first)};
+		ParallelFor((count + 1) / 2, threads_, [&](size_t pair) {
+			Fourier::ComplexVector& buffer {buffers[pair]};
+			const size_t start {(first + pair * 2) * hop_};
+			const bool second {pair * 2 + 1 < count};
+			for (size_t index {0}; index < frame_; index++)
+				buffer[index] = Fourier::Complex(Sample(start + index) * window[index],
+					second ? Sample(start + hop_ + index) * window[index] : 0.0_flt);
+			Fourier::FFT(buffer, false);
+			Samples& left {magnitudes[pair * 2]};
+			for (size_t bin {0}; bin < bins; bin++) {
+				const Fourier::Complex packed {buffer[bin]}, mirror {std::conj(buffer[(frame_ - bin) % frame_])};
+				const float_type scale {((bin == 0) || (bin * 2 == frame_) ? 0.5_flt : 1.0_flt) / window_sum};
+				left[bin] = std::abs(packed + mirror) * scale;
+				if (second)
+					magnitudes[pair * 2 + 1][bin] = std::abs(packed - mirror) * scale;
+			}
+		});
+		for (size_t index {0}; index < count; index++)
+			sink(first + index, magnitudes[index]);
+	}
+}
+
+void SpectrumAnalyser::WriteHeader(std::ostream& file, bool binary, size_t frames, size_t sample_rate) const {
+	if (binary) {
+		file.write("BOXYSPEC", 8);
+		for (const size_t value : {frames, bins(), sample_rate, frame_, hop_}) {
+			const uint32_t word {static_cast<uint32_t>(value)};
+			file.write(static_cast<const char*>(static_cast<const void*>(&word)), sizeof(word));
+		}
+		return;
+	}
+	std::string line {"time"};
+	for (size_t bin {0}; bin < bins(); bin++)
+		line += std::format(",{:.2f}", static_cast<double>(bin * sample_rate) / static_cast<double>(frame_));
+	file << line << '\n';
+}
+
+void SpectrumAnalyser::WriteFrame(std::ostream& file, bool binary, size_t index, const Samples& magnitudes, size_t sample_rate) const {
+	if (binary) {
+		const std::vector<float> row(magnitudes.begin(), magnitudes.end());
+		file.write(static_cast<const char*>(static_cast<const void*>(row.data())), static_cast<std::streamsize>(row.size() * sizeof(float)));
+		return;
+	}
+	std::string line {std::format("{:.4f}", static_cast<double>(index * hop_ + frame_ / 2) / static_cast<double>(sample_rate))};
+	for (const float_type magnitude : magnitudes)
+		line += std::format(",{:.6g}", magnitude);
+	file << line << '\n';
+}
+
+SpectralSummary::SpectralSummary(const SpectrumAnalyser& analyser, size_t sample_rate, size_t frames, bool plot) :
+		frame_{analyser.frame()}, hop_{analyser.hop()}, sample_rate_{sample_rate}, frames_{frames},
+		noise_bandwidth_{analyser.NoiseBandwidth()}, power_(analyser.bins(), 0.0) {
+	if (!plot || !frames_)
+		return;
+	columns_ = std::min(Screen::Width - 10, frames_);
+	grid_.assign(Rows, Samples(columns_, 0.0));
+	const float_type top {log(static_cast<float_type>(power_.size() - 1))};
+	for (size_t bin {0}; bin < power_.size(); bin++)
+		rows_.push_back(bin ? std::min(Rows - 1, static_cast<size_t>(static_cast<float_type>(Rows)
+			* log(static_cast<float_type>(bin)) / top)) : 0);
+}
+
+float_type SpectralSummary::Frequency(float_type bin) const noexcept {
+	return bin * static_cast<float_type>(sample_rate_) / static_cast<float_type>(frame_);
+}
+
+void SpectralSummary::Add(size_t index, const Samples& magnitudes) {
+	float_type energy {0.0}, weighted {0.0}, sum {0.0};
+	for (size_t bin {0}; bin < magnitudes.size(); bin++) {
+		const float_type power {magnitudes[bin] * magnitudes[bin]};
+		power_[bin] += power;
+		energy += power;
+		sum += magnitudes[bin];
+		weighted += magnitudes[bin] * Frequency(static_cast<float_type>(bin));
+		if (columns_) {
+			float_type& cell {grid_[rows_[bin]][index * columns_ / frames_]};
+			cell = std::max(cell, power);
+		}
+	}
+	if (sum > 0.0_flt) {
+		centroid_sum_ += energy * weighted / sum;
+		energy_sum_ += energy;
+	}
+	added_++;
+}
+
+void SpectralSummary::Print() const {
+	auto Decibels = [](float_type power) {
+		return (power > 0.0_flt) ? 10.0_flt * log10(power) : -999.0_flt;
+	};
+	const size_t bins {power_.size()};
+	const float_type frames {static_cast<float_type>(std::max<size_t>(added_, 1))},
+		nyquist {Frequency(static_cast<float_type>(bins - 1))};
+	screen.PrintFrame(std::format("{} frames of {} samples, hop {}, {} bins of {:.2f} Hz", added_,
+		frame_, hop_, bins, Frequency(1.0)));
+	screen.PrintFrame(std::format("Spectral centroid {:.1f} Hz",
+		(energy_sum_ > 0.0_flt) ? centroid_sum_ / energy_sum_ : 0.0_flt));
+	screen.PrintSeparatorSub();
+	screen.PrintFrame("Octave band energy (dBFS)");
+	for (float_type low {0.0}, high {62.5}; low < nyquist; low = high, high *= 2.0_flt) {
+		float_type band {0.0};
+		for (size_t bin {0}; bin < bins; bin++) {
+			const float_type frequency {Frequency(static_cast<float_type>(bin))};
+			if ((frequency >= low) && ((frequency < high) || (high >= nyquist)))
+				band += power_[bin];
+		}
+		screen.PrintFrame(std::format("{:>8.1f} - {:>8.1f} Hz {:>8.1f}", low, std::min(high, nyquist),
+			Decibels(band / frames / noise_bandwidth_)));
+	}
+	screen.PrintSeparatorSub();
+	screen.PrintFrame("Peak frequencies (dBFS)");
+	const float_type loudest {*std::max_element(power_.begin(), power_.end())},
+		threshold {loudest * pow(10.0_flt, -Range / 10.0_flt)};
+	std::vector<std::pair<float_type, float_type>> peaks;
+	for (size_t bin {1}; bin + 1 < bins; bin++) {
+		const float_type below {power_[bin - 1]}, here {power_[bin]}, above {power_[bin + 1]};
+		if ((here <= threshold) || (here <= below) || (here < above))
+			continue;
+		// Parabola through the log powers either side.
+		const float_type a {Decibels(below)}, b {Decibels(here)}, c {Decibels(above)},
+			curvature {a - 2.0_flt * b + c},
+			offset {(curvature < 0.0_flt) ? 0.5_flt * (a - c) / curvature : 0.0_flt};
+		peaks.emplace_back(b - 0.25_flt * (a - c) * offset, Frequency(static_cast<float_type>(bin) + offset));
+	}
+	std::ranges::sort(peaks, std::greater {});
+	peaks.resize(std::min(peaks.size(), MaxPeaks));
+	for (const auto& [level, frequency] : peaks)
+		screen.PrintFrame(std::format("{:>10.1f} Hz {:>8.1f}", frequency, level - Decibels(frames)));
+	if (columns_)
+		PrintHeatmap();
+}
+
+// Rows run from high to low frequency, labelled with their upper edge; shading
+// spans Range dB below the loudest cell.
+void SpectralSummary::PrintHeatmap() const {
+	static constexpr const char* Shades[] {" ", "░", "▒", "▓", "█"};
+	constexpr size_t levels {std::size(Shades)};
+	float_type loudest {0.0};
+	for (const Samples& row : grid_)
+		loudest = std::max(loudest, *std::max_element(row.begin(), row.end()));
+	screen.PrintSeparatorSub();
+	const float_type top {static_cast<float_type>(power_.size() - 1)};
+	for (size_t row {Rows}; row-- > 0;) {
+		const float_type frequency {Frequency(pow(top, static_cast<float_type>(row + 1) / static_cast<float_type>(Rows)))};
+		std::string line {(frequency >= 1000.0_flt) ? std::format("{:.1f}k", frequency / 1000.0_flt)
+			: std::format("{:.0f}", frequency)};
+		line = std::format("{:>7} ", line);
+		for (const float_type cell : grid_[row]) {
+			const float_type level {(cell > 0.0_flt) ? 10.0_flt * log10(cell / loudest) : -Range};
+			line += Shades[std::clamp(static_cast<int>((level + Range) / Range * static_cast<float_type>(levels)),
+				0, static_cast<int>(levels) - 1)];
+		}
+		screen.PrintFrame(line);
+	}
+	screen.PrintFrame(std::format("{:>7} 0 to {:.2f} s", "time", static_cast<float_type>(frames_ * hop_)
+		/ static_cast<float_type>(sample_rate_)));
+}
+
+} //end namespace BoxyLady
@@ -0,0 +1,81 @@
+//============================================================================
+// Name        : BoxyLady
+// Author      : Darren Green
+// Copyright   : (C) Darren Green 2011-2025
+// Description : Music sequencer
+//
+// License GPLv3+: GNU GPL version 3 or later <http://gnu.org/licenses/gpl.html>
+// This is free software; you are free to change and redistribute it.
+// There is NO WARRANTY, to the extent permitted by law.
+// Contact: darren.green@stir.ac.uk http://pinkmongoose.co.uk
+//============================================================================
+
+
+#ifndef SPECTROGRAM_H_
+#define SPECTROGRAM_H_
+
+#include <functional>
+#include <ostream>
+#include <vector>
+
+#include "Global.h"
+#include "Fourier.h"
+
+namespace BoxyLady {
+
+// Short-time Fourier analysis over Hann-windowed frames of `frame_` samples,
+// `hop_` apart. Each frame becomes frame_/2 + 1 magnitudes, scaled so that a
+// full-scale sine reads 1. Frames are transformed two to an FFT in parallel
+// batches and handed to the sink in order, so only one batch is held at a time.
+// Each window is mixed to mono straight from the interleaved samples.
+
+class SpectrumAnalyser {
+public:
+	using Samples = std::vector<float_type>;
+	using Sink = std::function<void(size_t, const Samples&)>;
+private:
+	static constexpr size_t Batch {64};
+	size_t frame_, hop_, threads_;
+public:
+	explicit SpectrumAnalyser(size_t, size_t, size_t);
+	size_t frame() const noexcept {return frame_;}
+	size_t hop() const noexcept {return hop_;}
+	size_t bins() const noexcept {return frame_ / 2 + 1;}
+	size_t Frames(size_t) const noexcept;
+	// Equivalent noise bandwidth of the window, in bins.
+	float_type NoiseBandwidth() const;
+	void Process(const MusicVector&, int, size_t, const Sink&) const;
+	// CSV has a header row of bin frequencies and a time column; binary is the
+	// magic "BOXYSPEC", then frames, bins, sample rate, frame and hop as uint32,
+	// then the magnitudes as float32, frame by frame.
+	void WriteHeader(std::ostream&, bool, size_t, size_t) const;
+	void WriteFrame(std::ostream&, bool, size_t, const Samples&, size_t) const;
+	static size_t DefaultFrame(size_t) noexcept;
+};
+
+// Running statistics over a spectrogram: mean power per bin, which gives the
+// octave band energies and the strongest peaks; the energy-weighted spectral
+// centroid; and an optional time by log-frequency grid for a heatmap.
+
+class SpectralSummary {
+private:
+	using Samples = SpectrumAnalyser::Samples;
+	static constexpr size_t Rows {16}, MaxPeaks {5};
+	static constexpr float_type Range {60.0};
+	size_t frame_, hop_, sample_rate_, frames_, columns_ {0}, added_ {0};
+	float_type noise_bandwidth_;
+	Samples power_;
+	float_type centroid_sum_ {0.0}, energy_sum_ {0.0};
+	std::vector<size_t> rows_;
+	std::vector<Samples> grid_;
+	float_type Frequency(float_type) const noexcept;
+	void PrintHeatmap() const;
+public:
+	explicit SpectralSummary(const SpectrumAnalyser&, size_t, size_t, bool);
+	void Add(size_t, const Samples&);
+	void Print() const;
+};
+
+} //end namespace BoxyLady
+
+#endif /* SPECTROGRAM_H_ */
@@ -334,7 +334,7 @@ PitchGamut& PitchGamut::TuningBlob(Blob& blob, [[maybe_unused]] bool makemusic)
 
 PitchGamut& PitchGamut::ParseBlob(Blob& blob, bool make_music) {
 	for (auto command : blob.children_) {
-		auto key {command.key_}, val {command.val_};
+		std::string key {command.key_}, val {command.val_};
 		if (key == "new")
 			Clear();
 		else if (key == "tuning")
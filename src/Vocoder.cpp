@@ -0,0 +1,189 @@
+//============================================================================
+// Name        : BoxyLady
+// Author      : Darren Green
+// Copyright   : (C) Darren Green 2011-2025
+// Description : Music sequencer
+//
+// License GPLv3+: GNU GPL version 3 or later <http://gnu.org/licenses/gpl.html>
+// This is free software; you are free to change and redistribute it.
+// There is NO WARRANTY, to the extent permitted by law.
+// Contact: darren.green@stir.ac.uk http://pinkmongoose.co.uk
+//============================================================================
+
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+
+#include "Vocoder.h"
+#include "Parallel.h"
+
+namespace BoxyLady {
+
+// Polynomial atan2, good to about 2e-6 rad and branch-free, so it runs several
+// times faster than the library call over a whole spectrum.
+inline float_type Phase(Fourier::Complex value) noexcept {
+	const float_type x {value.real()}, y {value.imag()}, abs_x {std::abs(x)}, abs_y {std::abs(y)},
+		ratio {std::min(abs_x, abs_y) / std::max({abs_x, abs_y, std::numeric_limits<float_type>::min()})},
+		square {ratio * ratio};
+	float_type angle {ratio * (0.99997726_flt + square * (-0.33262347_flt + square * (0.19354346_flt
+		+ square * (-0.11643287_flt + square * (0.05265332_flt - square * 0.01172120_flt)))))};
+	angle = (abs_y > abs_x) ? physics::TwoPi / 4.0_flt - angle : angle;
+	angle = (x < 0.0_flt) ? physics::TwoPi / 2.0_flt - angle : angle;
+	return std::copysign(angle, y);
+}
+
+PhaseVocoder::PhaseVocoder(size_t frame, size_t overlap, size_t threads) :
+		frame_{frame}, hop_{0}, threads_{threads ? threads : HardwareThreads()} {
+	if ((frame_ < 16) || !std::has_single_bit(frame_))
+		throw EError("Phase vocoder frame size must be a power of 2 of at least 16.");
+	if ((overlap < 2) || (frame_ % overlap))
+		throw EError("Phase vocoder overlap must be at least 2 and divide the frame size.");
+	hop_ = frame_ / overlap;
+}
+
+size_t PhaseVocoder::DefaultFrame(size_t sample_rate) noexcept {
+	return std::bit_floor(std::max<size_t>(sample_rate / 10, 256));
+}
+
+// Splits the spectrum at the quietest bin between neighbouring peaks.
+void PhaseVocoder::FindRegions(const Samples& magnitude, float_type pitch, std::vector<Region>& regions) {
+	const size_t bins {magnitude.size()};
+	regions.clear();
+	for (size_t bin {0}; bin < bins; bin++) {
+		if ((magnitude[bin] <= 0.0_flt) || ((bin > 0) && (magnitude[bin] <= magnitude[bin - 1]))
+				|| ((bin + 1 < bins) && (magnitude[bin] < magnitude[bin + 1])))
+			continue;
+		size_t first {0};
+		if (!regions.empty()) {
+			first = regions.back().peak + 1;
+			for (size_t trough {first + 1}; trough < bin; trough++)
+				if (magnitude[trough] < magnitude[first])
+					first = trough;
+			regions.back().last = first;
+		}
+		regions.push_back({first, bins, bin, static_cast<size_t>(std::lround(static_cast<float_type>(bin) * pitch)), 0.0});
+	}
+}
+
+// Stretch scales the length, pitch scales every frequency; output has `length` samples.
+PhaseVocoder::Samples PhaseVocoder::Process(const Samples& input, size_t length, float_type stretch, float_type pitch) const {
+	auto Wrap = [](float_type phase) {
+		return phase - physics::TwoPi * std::round(phase / physics::TwoPi);
+	};
+	const size_t bins {frame_ / 2 + 1}, frames {(length + frame_ - 1) / hop_ + 1}, batch_size {std::min(Batch, frames)};
+	const auto window_pointer {Fourier::Window(frame_ / 2)};
+	const Fourier::Curve& window {*window_pointer};
+	float_type window_power {0.0};
+	for (const float_type value : window)
+		window_power += value * value;
+	const float_type norm {static_cast<float_type>(hop_) / window_power},
+		synthesis_hop {static_cast<float_type>(hop_)};
+	auto Start = [this, stretch](size_t frame) {
+		const float_type centre {(static_cast<float_type>(frame * hop_) - static_cast<float_type>(frame_) / 2.0_flt) / stretch};
+		return static_cast<long long>(std::lround(centre)) - static_cast<long long>(frame_ / 2);
+	};
+	auto Sample = [&input](long long position) {
+		return ((position >= 0) && (position < static_cast<long long>(input.size()))) ? input[position] : 0.0_flt;
+	};
+	std::vector<Fourier::ComplexVector> spectra(batch_size, Fourier::ComplexVector(frame_)),
+		shifted(batch_size, Fourier::ComplexVector(bins));
+	std::vector<Samples> phases(batch_size, Samples(bins));
+	std::vector<std::vector<Region>> regions(batch_size);
+	Samples output(length, 0.0), last_phase(bins, 0.0), synthesis_phase(bins, 0.0), next_phase(bins);
+	for (size_t batch {0}; batch < frames; batch += Batch) {
+		const size_t count {std::min(Batch, frames - batch)};
+		// Frames go through the FFT in pairs, packed as the real and imaginary parts.
+		ParallelFor((count + 1) / 2, threads_, [&](size_t pair) {
+			const size_t first {pair * 2}, second {first + 1}, stop {std::min(first + 2, count)};
+			const bool paired {second < count};
+			Fourier::ComplexVector& spectrum {spectra[first]};
+			const long long start_first {Start(batch + first)}, start_second {paired ? Start(batch + second) : 0};
+			for (size_t sample {0}; sample < frame_; sample++) {
+				const long long offset {static_cast<long long>(sample)};
+				spectrum[sample] = Fourier::Complex(Sample(start_first + offset),
+					paired ? Sample(start_second + offset) : 0.0_flt) * window[sample];
+			}
+			Fourier::FFT(spectrum, false);
+			for (size_t bin {0}; bin < bins; bin++) {
+				const Fourier::Complex packed {spectrum[bin]}, mirror {std::conj(spectrum[(frame_ - bin) % frame_])};
+				spectrum[bin] = (packed + mirror) * 0.5_flt;
+				if (paired)
+					spectra[second][bin] = (packed - mirror) * Fourier::Complex(0.0, -0.5);
+			}
+			// The forward FFT uses exp(+i), so phases are negated to run forward in time.
+			for (size_t index {first}; index < stop; index++) {
+				for (size_t bin {0}; bin < bins; bin++)
+					phases[index][bin] = std::sqrt(std::norm(spectra[index][bin]));
+				FindRegions(phases[index], pitch, regions[index]);
+				for (size_t bin {0}; bin < bins; bin++)
+					phases[index][bin] = -Phase(spectra[index][bin]);
+			}
+		});
+		// Peaks advance at their measured frequency; the rest of each region keeps its phase relative to the peak.
+		for (size_t index {0}; index < count; index++) {
+			const size_t frame {batch + index};
+			const Samples& phase {phases[index]};
+			const float_type analysis_hop {frame ? static_cast<float_type>(Start(frame) - Start(frame - 1)) : 0.0_flt};
+			next_phase = synthesis_phase;
+			for (Region& region : regions[index]) {
+				if (region.target >= bins)
+					break;
+				const float_type centre {physics::TwoPi * static_cast<float_type>(region.peak) / static_cast<float_type>(frame_)},
+					frequency {(analysis_hop > 0.0_flt) ?
+						centre + Wrap(phase[region.peak] - last_phase[region.peak] - centre * analysis_hop) / analysis_hop : centre},
+					peak_phase {frame ? Wrap(synthesis_phase[region.target] + frequency * pitch * synthesis_hop) : phase[region.peak]};
+				region.rotation = phase[region.peak] - peak_phase;
+				for (size_t bin {region.first}; bin < region.last; bin++) {
+					const size_t shifted_bin {bin + region.target - region.peak};
+					if ((bin + region.target >= region.peak) && (shifted_bin < bins))
+						next_phase[shifted_bin] = phase[bin] - region.rotation;
+				}
+			}
+			synthesis_phase.swap(next_phase);
+			last_phase = phase;
+		}
+		ParallelFor((count + 1) / 2, threads_, [&](size_t pair) {
+			const size_t first {pair * 2}, second {first + 1}, stop {std::min(first + 2, count)};
+			for (size_t index {first}; index < stop; index++) {
+				Fourier::ComplexVector& result {shifted[index]};
+				std::fill(result.begin(), result.end(), Fourier::Complex {0.0});
+				for (const Region& region : regions[index]) {
+					if (region.target >= bins)
+						break;
+					const Fourier::Complex rotation {std::polar(1.0_flt, region.rotation)};
+					for (size_t bin {region.first}; bin < region.last; bin++) {
+						const size_t shifted_bin {bin + region.target - region.peak};
+						if ((bin + region.target >= region.peak) && (shifted_bin < bins))
+							result[shifted_bin] += spectra[index][bin] * rotation;
+					}
+				}
+			}
+			Fourier::ComplexVector& spectrum {spectra[first]};
+			for (size_t bin {0}; bin < bins; bin++) {
+				Fourier::Complex value {shifted[first][bin]}, other_value {(second < count) ? shifted[second][bin] : Fourier::Complex {0.0}};
+				if ((bin == 0) || (bin + 1 == bins)) {
+					value = value.real();
+					other_value = other_value.real();
+				}
+				spectrum[bin] = value + Fourier::Complex(0.0, 1.0) * other_value;
+				if ((bin > 0) && (bin + 1 < bins))
+					spectrum[frame_ - bin] = std::conj(value) + Fourier::Complex(0.0, 1.0) * std::conj(other_value);
+			}
+			Fourier::FFT(spectrum, true);
+		});
+		for (size_t index {0}; index < count; index++) {
+			const Fourier::ComplexVector& spectrum {spectra[index & ~size_t {1}]};
+			const long long start {static_cast<long long>((batch + index) * hop_) - static_cast<long long>(frame_)};
+			for (size_t sample {0}; sample < frame_; sample++) {
+				const long long position {start + static_cast<long long>(sample)};
+				if ((position >= 0) && (position < static_cast<long long>(length)))
+					output[position] += ((index % 2) ? spectrum[sample].imag() : spectrum[sample].real()) * window[sample] * norm;
+			}
+		}
+	}
+	return output;
+}
+
+} //end namespace BoxyLady
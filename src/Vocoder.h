@@ -0,0 +1,50 @@
+//============================================================================
+// Name        : BoxyLady
+// Author      : Darren Green
+// Copyright   : (C) Darren Green 2011-2025
+// Description : Music sequencer
+//
+// License GPLv3+: GNU GPL version 3 or later <http://gnu.org/licenses/gpl.html>
+// This is free software; you are free to change and redistribute it.
+// There is NO WARRANTY, to the extent permitted by law.
+// Contact: darren.green@stir.ac.uk http://pinkmongoose.co.uk
+//============================================================================
+
+
+#ifndef VOCODER_H_
+#define VOCODER_H_
+
+#include <vector>
+
+#include "Global.h"
+#include "Fourier.h"
+
+namespace BoxyLady {
+
+// Phase vocoder over Hann-windowed frames of `frame_` samples, `hop_` apart.
+// Each bin's true frequency comes from its phase advance between frames. Bins
+// are moved to their new pitch, spectral peaks have their phase advanced, and
+// the bins around each peak keep their phase relative to it (identity phase
+// locking). FFTs run in parallel batches; only the phase pass is serial.
+
+class PhaseVocoder {
+public:
+	using Samples = std::vector<float_type>;
+private:
+	static constexpr size_t Batch {64};
+	// Bins [first, last) around a peak move together to the peak's target bin.
+	struct Region {
+		size_t first, last, peak, target;
+		float_type rotation;
+	};
+	size_t frame_, hop_, threads_;
+	static void FindRegions(const Samples&, float_type, std::vector<Region>&);
+public:
+	explicit PhaseVocoder(size_t, size_t, size_t);
+	Samples Process(const Samples&, size_t, float_type, float_type) const;
+	static size_t DefaultFrame(size_t) noexcept;
+};
+
+} //end namespace BoxyLady
+
+#endif /* VOCODER_H_ */
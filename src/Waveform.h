@@ -15,6 +15,8 @@
 
 #include <numbers>
 
+#include "Memory.h"
+
 namespace BoxyLady {
 
 class Sound;
@@ -26,7 +28,7 @@ namespace physics {
 } //end namespace Physics
 
 using music_type = int16_t;
-using MusicVector = std::vector<music_type>;
+using MusicVector = std::vector<music_type, CountingAllocator<music_type>>;
 
 //-----------------
 
@@ -0,0 +1,129 @@
+//============================================================================
+// Name        : BoxyLady
+// Author      : Darren Green
+// Copyright   : (C) Darren Green 2011-2025
+// Description : Music sequencer
+//
+// License GPLv3+: GNU GPL version 3 or later <http://gnu.org/licenses/gpl.html>
+// This is free software; you are free to change and redistribute it.
+// There is NO WARRANTY, to the extent permitted by law.
+// Contact: darren.green@stir.ac.uk http://pinkmongoose.co.uk
+//============================================================================
+
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <complex>
+
+#include "Waveguide.h"
+
+namespace BoxyLady {
+
+// period is in frames; pluck is the pluck position as a fraction of the
+// string, and dispersion the stiffness, from 0 towards 1. The line is
+// shortened by the phase delay of every loop filter at the fundamental and
+// the remaining 0.1-1.1 frames go to the tuning allpass, whose coefficient
+// gives that delay exactly at the fundamental.
+Waveguide::Waveguide(float_type period, float_type gain, float_type damping, float_type dispersion,
+		float_type pluck, std::vector<float_type> blends, std::vector<float_type> reverses, const FilterChain& chain) :
+		chain_{chain}, blends_{std::move(blends)}, reverses_{std::move(reverses)}, gain_{gain},
+		damping_{damping}, dispersion_{-dispersion} {
+	if (!chain_.isStreaming())
+		throw EError("Karplus-Strong: Fourier and pitch_scale filters cannot go in the string loop.");
+	const float_type w {physics::TwoPi / period};
+	const std::complex<float_type> z {std::polar(1.0_flt, -w)};
+	float_type delay {chain_.PhaseDelay(w) - std::arg(1.0_flt - damping_ + damping_ * z) / w};
+	if (dispersion_ != 0.0_flt)
+		delay -= static_cast<float_type>(DispersionStages) * std::arg((dispersion_ + z) / (1.0_flt + dispersion_ * z)) / w;
+	const float_type remainder {period - delay - 0.1_flt};
+	if (remainder < 1.0_flt)
+		throw EError("Karplus-Strong: the loop filters delay the string by more than its period.");
+	length_ = static_cast<size_t>(remainder);
+	const float_type fraction {period - delay - static_cast<float_type>(length_)};
+	tuning_ = sin(0.5_flt * w * (1.0_flt - fraction)) / sin(0.5_flt * w * (1.0_flt + fraction));
+	pluck_ = static_cast<size_t>(std::round(std::clamp(pluck, 0.0_flt, 1.0_flt) * period));
+}
+
+template <size_t Lanes>
+void Waveguide::Run(const MusicVector& excitation, size_t excitation_frames, std::vector<float_type>& output,
+		size_t frames, Darren::Random<float_type>& random) const {
+	// A reversed trip reads the whole previous trip back to front while its own
+	// writes advance, so it needs two trips of line rather than one.
+	const size_t block {std::min(Block, length_)},
+		mask {std::bit_ceil(reverses_.empty() ? length_ + 1 : 2 * length_) - 1};
+	std::vector<float_type> line((mask + 1) * Lanes, 0.0);
+	auto Line = [&line, mask](size_t position, size_t lane) -> float_type& {
+		return line[(position & mask) * Lanes + lane];
+	};
+	auto Excitation = [&excitation, excitation_frames](size_t position, size_t lane) {
+		return (position < excitation_frames) ? static_cast<float_type>(excitation[position * Lanes + lane]) / PCMMax_f : 0.0_flt;
+	};
+	std::array<float_type, Block * Lanes> buffer;
+	std::vector<FilterChain::Memory> memory {chain_.Start()};
+	std::array<float_type, Lanes> damping_state {}, tuning_input {}, tuning_output {};
+	std::array<std::array<float_type, Lanes>, DispersionStages> dispersion_input {}, dispersion_output {};
+	float_type sign {1.0};
+	bool reversed {false};
+	for (size_t start {0}; start < frames; ) {
+		const size_t trip_start {start - start % length_},
+			count {std::min({block, frames - start, trip_start + length_ - start})};
+		if ((start == trip_start) && (start >= length_)) {
+			sign = 1.0;
+			reversed = false;
+			for (const float_type blend : blends_)
+				if (random.uniform() > blend)
+					sign = -sign;
+			for (const float_type reverse : reverses_)
+				if (random.uniform() > reverse)
+					reversed = !reversed;
+		}
+		for (size_t frame {0}; frame < count; frame++) {
+			const size_t position {start + frame};
+			for (size_t lane {0}; lane < Lanes; lane++)
+				buffer[frame * Lanes + lane] = (position < length_) ? 0.0_flt
+					: sign * Line(reversed ? 2 * trip_start - 1 - position : position - length_, lane);
+		}
+		chain_.Stream<Lanes>(buffer.data(), count, memory);
+		for (size_t frame {0}; frame < count; frame++) {
+			const size_t position {start + frame};
+			for (size_t lane {0}; lane < Lanes; lane++) {
+				float_type value {buffer[frame * Lanes + lane]};
+				const float_type damped {(1.0_flt - damping_) * value + damping_ * damping_state[lane]};
+				damping_state[lane] = value;
+				value = damped;
+				if (dispersion_ != 0.0_flt)
+					for (size_t stage {0}; stage < DispersionStages; stage++) {
+						const float_type passed {dispersion_ * (value - dispersion_output[stage][lane]) + dispersion_input[stage][lane]};
+						dispersion_input[stage][lane] = value;
+						dispersion_output[stage][lane] = passed;
+						value = passed;
+					}
+				const float_type tuned {tuning_ * (gain_ * value - tuning_output[lane]) + tuning_input[lane]};
+				tuning_input[lane] = gain_ * value;
+				tuning_output[lane] = tuned;
+				float_type input {Excitation(position, lane)};
+				if (pluck_ && (position >= pluck_))
+					input -= Excitation(position - pluck_, lane);
+				const float_type sample {std::clamp(input + tuned, -1.0_flt, 1.0_flt)};
+				Line(position, lane) = sample;
+				output[position * Lanes + lane] = sample;
+			}
+		}
+		start += count;
+	}
+}
+
+void Waveguide::Process(const MusicVector& excitation, size_t excitation_frames, std::vector<float_type>& output,
+		int channels, size_t frames, Darren::Random<float_type> random) const {
+	output.assign(frames * static_cast<size_t>(channels), 0.0);
+	if (channels == 1)
+		Run<1>(excitation, excitation_frames, output, frames, random);
+	else if (channels == 2)
+		Run<2>(excitation, excitation_frames, output, frames, random);
+	else
+		throw EError("Karplus-Strong only works on 1-2 channels.");
+}
+
+} //end namespace BoxyLady
@@ -0,0 +1,51 @@
+//============================================================================
+// Name        : BoxyLady
+// Author      : Darren Green
+// Copyright   : (C) Darren Green 2011-2025
+// Description : Music sequencer
+//
+// License GPLv3+: GNU GPL version 3 or later <http://gnu.org/licenses/gpl.html>
+// This is free software; you are free to change and redistribute it.
+// There is NO WARRANTY, to the extent permitted by law.
+// Contact: darren.green@stir.ac.uk http://pinkmongoose.co.uk
+//============================================================================
+
+
+#ifndef WAVEGUIDE_H_
+#define WAVEGUIDE_H_
+
+#include <vector>
+
+#include "Global.h"
+#include "Random.h"
+#include "FilterChain.h"
+
+namespace BoxyLady {
+
+// Digital waveguide string, streamed in one pass. A circular line of
+// `length_` frames holds one trip round the string; each trip passes through
+// the filter chain, a two-tap damping filter, a cascade of dispersion
+// allpasses, the loop gain and a first-order allpass set so the whole loop
+// delays the fundamental by exactly one period. ks:blend and ks:reverse
+// flip or reverse whole trips at random, as they did for repeated grains.
+// The excitation is fed in at the start, through a comb for the pluck
+// position.
+
+class Waveguide {
+private:
+	static constexpr size_t Block {256}, DispersionStages {4};
+	const FilterChain& chain_;
+	std::vector<float_type> blends_, reverses_;
+	float_type gain_, damping_, dispersion_, tuning_;
+	size_t length_, pluck_;
+	template <size_t Lanes>
+	void Run(const MusicVector&, size_t, std::vector<float_type>&, size_t, Darren::Random<float_type>&) const;
+public:
+	explicit Waveguide(float_type, float_type, float_type, float_type, float_type,
+		std::vector<float_type>, std::vector<float_type>, const FilterChain&);
+	void Process(const MusicVector&, size_t, std::vector<float_type>&, int, size_t, Darren::Random<float_type>) const;
+};
+
+} //end namespace BoxyLady
+
+#endif /* WAVEGUIDE_H_ */
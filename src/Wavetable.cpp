@@ -0,0 +1,63 @@
+//============================================================================
+// Name        : BoxyLady
+// Author      : Darren Green
+// Copyright   : (C) Darren Green 2011-2025
+// Description : Music sequencer
+//
+// License GPLv3+: GNU GPL version 3 or later <http://gnu.org/licenses/gpl.html>
+// This is free software; you are free to change and redistribute it.
+// There is NO WARRANTY, to the extent permitted by law.
+// Contact: darren.green@stir.ac.uk http://pinkmongoose.co.uk
+//============================================================================
+
+
+#include <map>
+#include <mutex>
+#include <tuple>
+
+#include "Wavetable.h"
+#include "Fourier.h"
+
+namespace BoxyLady {
+
+Wavetable::Wavetable(Shape shape, float_type parameter) {
+	constexpr size_t oversampled {Size * 8};
+	Fourier::ComplexVector period(oversampled);
+	for (size_t index {0}; index < oversampled; index++)
+		period[index] = shape(static_cast<float_type>(index) / static_cast<float_type>(oversampled), parameter);
+	Fourier::FFT(period, false);
+	const float_type scale {static_cast<float_type>(Size) / static_cast<float_type>(oversampled)};
+	Fourier::ComplexVector spectrum(Size);
+	for (size_t level {0}; level < Levels; level++) {
+		const size_t harmonics {Harmonics(level)};
+		std::fill(spectrum.begin(), spectrum.end(), Fourier::Complex {0.0});
+		spectrum[0] = period[0] * scale;
+		for (size_t harmonic {1}; harmonic <= harmonics; harmonic++) {
+			spectrum[harmonic] = period[harmonic] * scale;
+			spectrum[Size - harmonic] = period[oversampled - harmonic] * scale;
+		}
+		Fourier::FFT(spectrum, true);
+		std::vector<float_type>& table {levels_[level]};
+		table.resize(Size + 1);
+		for (size_t index {0}; index < Size; index++)
+			table[index] = spectrum[index].real();
+		table[Size] = table[0];
+	}
+}
+
+std::shared_ptr<const Wavetable> Wavetable::Cached(int kind, float_type parameter, Shape shape) {
+	constexpr size_t MaxTables {32};
+	static std::mutex mutex;
+	static std::map<std::tuple<int, float_type>, std::shared_ptr<const Wavetable>> tables;
+	const std::lock_guard lock {mutex};
+	const std::tuple<int, float_type> key {kind, parameter};
+	if (const auto found {tables.find(key)}; found != tables.end())
+		return found->second;
+	if (tables.size() >= MaxTables)
+		tables.clear();
+	auto table {std::make_shared<const Wavetable>(shape, parameter)};
+	tables[key] = table;
+	return table;
+}
+
+} //end namespace BoxyLady
@@ -0,0 +1,82 @@
+//============================================================================
+// Name        : BoxyLady
+// Author      : Darren Green
+// Copyright   : (C) Darren Green 2011-2025
+// Description : Music sequencer
+//
+// License GPLv3+: GNU GPL version 3 or later <http://gnu.org/licenses/gpl.html>
+// This is free software; you are free to change and redistribute it.
+// There is NO WARRANTY, to the extent permitted by law.
+// Contact: darren.green@stir.ac.uk http://pinkmongoose.co.uk
+//============================================================================
+
+
+#ifndef WAVETABLE_H_
+#define WAVETABLE_H_
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "Global.h"
+#include "Waveform.h"
+
+namespace BoxyLady {
+
+// Band-limited single-cycle tables, two mip levels per octave: level k keeps
+// the harmonics up to MaxHarmonics / 2^(k/2), and the last level only the DC
+// term. Levels are chosen by phase velocity in cycles per sample, so
+// one table set serves every sample rate. Tables are built from a finely
+// sampled period by FFT, then shared.
+
+class Wavetable {
+public:
+	using Shape = float_type (*)(float_type, float_type);
+	static constexpr size_t Size {8192}, MaxHarmonics {1024}, Levels {22};
+private:
+	std::array<std::vector<float_type>, Levels> levels_;
+public:
+	explicit Wavetable(Shape, float_type);
+	// The first level whose top partial stays below Nyquist.
+	static size_t Level(float_type velocity) noexcept {
+		const float_type partials {std::abs(velocity) * static_cast<float_type>(MaxHarmonics * 2)};
+		if (partials <= 1.0_flt)
+			return 0;
+		return std::min(Levels - 1, static_cast<size_t>(std::ceil(2.0_flt * log2(partials))));
+	}
+	static size_t Harmonics(size_t level) noexcept {
+		return (level < Levels - 1) ? static_cast<size_t>(static_cast<float_type>(MaxHarmonics)
+			* std::exp2(-0.5_flt * static_cast<float_type>(level))) : 0;
+	}
+	float_type Lookup(float_type phi, size_t level) const noexcept {
+		if ((phi < 0.0_flt) || (phi >= 1.0_flt))
+			phi = ModPhi(phi);
+		const float_type position {phi * static_cast<float_type>(Size)};
+		const size_t index {std::min(static_cast<size_t>(position), Size - 1)};
+		const float_type fraction {position - static_cast<float_type>(index)};
+		const std::vector<float_type>& table {levels_[level]};
+		return table[index] + (table[index + 1] - table[index]) * fraction;
+	}
+	// Keyed by waveform kind and shape parameter.
+	static std::shared_ptr<const Wavetable> Cached(int, float_type, Shape);
+};
+
+// Polynomial correction for a unit step down at phase 0, for shapes whose
+// parameters change too fast to tabulate.
+inline float_type PolyBLEP(float_type phase, float_type velocity) noexcept {
+	if (phase < velocity) {
+		const float_type t {phase / velocity};
+		return t + t - t * t - 1.0_flt;
+	}
+	if (phase > 1.0_flt - velocity) {
+		const float_type t {(phase - 1.0_flt) / velocity};
+		return t * t + t + t + 1.0_flt;
+	}
+	return 0.0_flt;
+}
+
+} //end namespace BoxyLady
+
+#endif /* WAVETABLE_H_ */